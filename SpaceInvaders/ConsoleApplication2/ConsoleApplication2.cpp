@@ -1,11 +1,108 @@
 ﻿#include <SFML/Graphics.hpp>
 #include <SFML/Audio.hpp>
 #include <unordered_map>
-#include <queue>
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <map>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <new>
+#include <cstdint>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
+// zestaw instrukcji dla testów kolizji wybierany przy kompilacji (/arch:AVX lub -mavx włącza AVX)
+#if defined(__AVX__)
+#include <immintrin.h>
+#define COLLISION_SIMD_AVX
+#define COLLISION_SIMD_NAME "AVX"
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COLLISION_SIMD_SSE2
+#define COLLISION_SIMD_NAME "SSE2"
+#else
+#define COLLISION_SIMD_NAME "scalar"
+#endif
 
-sf::RenderWindow window(sf::VideoMode(1000, 700), "(Space invaders)-like game");
-std::unordered_map<std::string, sf::Texture> textures;
+// licznik alokacji na stercie - tryb headless sprawdza nim, że klatki w stanie ustalonym nie alokują pamięci;
+// podmienia globalne operatory new/delete, więc jest wkompilowany tylko przy COUNT_ALLOCATIONS (np. -DCOUNT_ALLOCATIONS)
+#ifdef COUNT_ALLOCATIONS
+const bool allocationsCounted = true;
+std::atomic<long long> allocationsCount(0);
+
+void* operator new(std::size_t size)
+{
+	allocationsCount.fetch_add(1, std::memory_order_relaxed);
+	if (void* memory = std::malloc(size == 0 ? 1 : size))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+// GCC po wstawieniu free() w miejsce delete bierze tę parę za niedopasowaną (-Wmismatched-new-delete), choć new wyżej używa malloc()
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	operator delete(memory);
+}
+#else
+const bool allocationsCounted = false;
+const long long allocationsCount = 0;
+#endif
+
+// okno jest tworzone dopiero w main(), w trybie headless nie powstaje wcale
+std::unique_ptr<sf::RenderWindow> window;
+bool headless = false;
 
 float deltaTime = (1.f / 120);
 
@@ -48,760 +145,4778 @@ enum class Direction
 	DOWN
 };
 
-void drawObject(sf::Sprite& sprite, Vector2f objectPosition)
+// plik zmapowany w pamięci tylko do odczytu - dane są czytane bezpośrednio ze strony systemu plików, bez kopiowania
+class MappedFile
 {
-	//sf::Vector2u size = sprite.getTexture()->getSize();
-	sprite.setPosition(sf::Vector2f(objectPosition.x, objectPosition.y));
-	window.draw(sprite);
-}
+public:
+	MappedFile()
+		:data_(nullptr), size_(0)
+#ifdef _WIN32
+		, file_(INVALID_HANDLE_VALUE), mapping_(NULL)
+#endif
+	{ }
 
-class Bullet
-{
-#define BULLET_SPEED 200
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
 
-public:
-	Bullet(Vector2f position, Direction direction)
-		:position_(position), direction_(direction), alive_(true)
+	~MappedFile()
 	{
-		if (direction == Direction::UP)
-			sprite_.setTexture(textures["bullet_green"]);
-		else
-			sprite_.setTexture(textures["bullet_red"]);
+		close();
 	}
 
-	void update()
+	bool open(const std::string& path)
 	{
-		// poruszanie się pocisku
-		if (direction_ == Direction::DOWN)
-			position_ += Vector2f(0, BULLET_SPEED) * deltaTime;
-		else
-			position_ += Vector2f(0, -BULLET_SPEED) * deltaTime;
-	}
+		close();
+#ifdef _WIN32
+		file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file_ == INVALID_HANDLE_VALUE)
+			return false;
 
-	void setPosition(Vector2f position)
-	{
-		position_ = position;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0)
+		{
+			close();
+			return false;
+		}
+		mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping_ != NULL)
+			data_ = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+		if (data_ == nullptr)
+		{
+			close();
+			return false;
+		}
+		size_ = (size_t)size.QuadPart;
+#else
+		int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0)
+			return false;
+
+		struct stat info;
+		if (fstat(file, &info) != 0 || info.st_size == 0)
+		{
+			::close(file);
+			return false;
+		}
+		void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		::close(file);
+		if (data == MAP_FAILED)
+			return false;
+
+		data_ = data;
+		size_ = (size_t)info.st_size;
+#endif
+		return true;
 	}
-	
-	sf::Sprite& getSprite()
+
+	void close()
 	{
-		return sprite_;
+#ifdef _WIN32
+		if (data_ != nullptr)
+			UnmapViewOfFile(data_);
+		if (mapping_ != NULL)
+			CloseHandle(mapping_);
+		if (file_ != INVALID_HANDLE_VALUE)
+			CloseHandle(file_);
+		mapping_ = NULL;
+		file_ = INVALID_HANDLE_VALUE;
+#else
+		if (data_ != nullptr)
+			munmap((void*)data_, size_);
+#endif
+		data_ = nullptr;
+		size_ = 0;
 	}
 
-	Vector2f getPosition()
+	const unsigned char* data() const
 	{
-		return position_;
+		return (const unsigned char*)data_;
 	}
 
-	Direction getDirection()
+	size_t size() const
 	{
-		return direction_;
+		return size_;
 	}
 
-	void kill()
+private:
+	const void* data_;
+	size_t size_;
+#ifdef _WIN32
+	HANDLE file_;
+	HANDLE mapping_;
+#endif
+};
+
+// czas ostatniej modyfikacji pliku w sekundach albo 0, jeśli pliku nie ma
+long long getModificationTime(const std::string& path)
+{
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return 0;
+	return (long long)info.st_mtime;
+}
+
+// rozdziela indeksy 0..count-1 między wątki - każdy wątek bierze kolejny wolny indeks, aż wszystkie zostaną obsłużone
+template <typename Function>
+void runInParallel(int count, Function function)
+{
+	std::atomic<int> next(0);
+	auto worker = [&]()
 	{
-		alive_ = false;
-	}
+		for (int i = next++; i < count; i = next++)
+			function(i);
+	};
+
+	int threadsCount = std::min(count, (int)std::max(1u, std::thread::hardware_concurrency()));
+	std::vector<std::thread> threads;
+	for (int i = 1; i < threadsCount; i++)
+		threads.push_back(std::thread(worker));
+	worker();
+	for (auto& thread : threads)
+		thread.join();
+}
+
+// kawałki jednego wywołania parallelFor; ostatni wykonany kawałek zeruje remaining
+class JobBatch
+{
+public:
+	JobBatch(int chunksCount)
+		:remaining(chunksCount)
+	{ }
+
+	virtual void run(int chunk) = 0;
+
+	std::atomic<int> remaining;
+};
+
+template <typename Function>
+class FunctionJobBatch : public JobBatch
+{
+public:
+	FunctionJobBatch(Function& function, int count, int chunkSize, int chunksCount)
+		:JobBatch(chunksCount), function_(function), count_(count), chunkSize_(chunkSize)
+	{ }
 
-	bool isAlive()
+	void run(int chunk) override
 	{
-		return alive_;
+		int begin = chunk * chunkSize_;
+		function_(chunk, begin, std::min(count_, begin + chunkSize_));
 	}
 
 private:
-	Vector2f position_;
-	Direction direction_;
-	sf::Sprite sprite_;
-	bool alive_;
+	Function& function_;
+	int count_;
+	int chunkSize_;
 };
-std::vector<Bullet> bullets;
 
-class Spaceship
+class Job
 {
 public:
-	Spaceship(int hp, int speed, Vector2f position, float shootingSpeed)
-		:hp_(hp), speed_(speed), shootingSpeed_(shootingSpeed), timeFromLastBullet_(0), position_(position)
+	JobBatch* batch;
+	int chunk;
+};
+
+// kolejka jednego wątku: właściciel zdejmuje z końca, inne wątki podkradają z początku
+class JobQueue
+{
+#define JOB_QUEUE_CAPACITY 4096
+
+public:
+	JobQueue()
+		:first_(0), count_(0)
 	{ }
 
-	virtual void update() = 0;
-	
-	sf::Sprite& getSprite()
+	bool push(Job job)
 	{
-		return sprite_;
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (count_ == JOB_QUEUE_CAPACITY)
+			return false;
+		jobs_[(first_ + count_) % JOB_QUEUE_CAPACITY] = job;
+		count_++;
+		return true;
 	}
 
-	void setTexture(const std::string& texture)
+	bool popBack(Job& job)
 	{
-		sprite_.setTexture(textures[texture]);
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (count_ == 0)
+			return false;
+		count_--;
+		job = jobs_[(first_ + count_) % JOB_QUEUE_CAPACITY];
+		return true;
 	}
 
-	void setPosition(Vector2f position)
+	bool popFront(Job& job)
 	{
-		position_ = position;
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (count_ == 0)
+			return false;
+		job = jobs_[first_];
+		first_ = (first_ + 1) % JOB_QUEUE_CAPACITY;
+		count_--;
+		return true;
 	}
 
-	Vector2f getSize()
+private:
+	std::mutex mutex_;
+	Job jobs_[JOB_QUEUE_CAPACITY];
+	int first_;
+	int count_;
+};
+
+// planista zadań z podkradaniem pracy dla pętli po obiektach symulacji. parallelFor dzieli zakres na kawałki
+// rozkładane po kolejkach wątków, a wywołujący wątek też je wykonuje; kawałki nie zależą od siebie,
+// więc wynik jest taki sam przy dowolnej liczbie wątków. parallelFor wywołuje naraz tylko jeden wątek.
+class JobSystem
+{
+public:
+	JobSystem()
+		:stopping_(false), pending_(0)
+	{ }
+
+	~JobSystem()
 	{
-		return Vector2f(getSprite().getTexture()->getSize().x, getSprite().getTexture()->getSize().x);
+		stop();
 	}
 
-	Vector2f getPostion()
+	void start(int threadsCount)
 	{
-		return position_;
+		threadsCount = std::max(1, threadsCount);
+		for (int i = 0; i < threadsCount; i++)
+			queues_.push_back(std::unique_ptr<JobQueue>(new JobQueue()));
+		for (int i = 1; i < threadsCount; i++)
+			workers_.push_back(std::thread(&JobSystem::work, this, i));
 	}
 
-	int getHp()
+	void stop()
 	{
-		return hp_;
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex_);
+			stopping_ = true;
+		}
+		wake_.notify_all();
+		for (auto& worker : workers_)
+			worker.join();
+		workers_.clear();
 	}
 
-	void takeDamage(int damage)
+	int getThreadsCount()
 	{
-		hp_ -= damage;
-		if (hp_ <= 0)
-			hp_ = 0;
+		return std::max(1, (int)queues_.size());
 	}
 
-	void shoot(Direction direction)
+	static int getChunksCount(int count, int chunkSize)
 	{
-		auto size = getSize();
-		auto bullet = Bullet(position_ + Vector2f(size.x, (direction == Direction::DOWN) ? size.y : -(float)size.y)*0.5, direction);
-		auto bulletSize = bullet.getSprite().getTexture()->getSize();
-		bullet.setPosition(bullet.getPosition() + Vector2f(-(float)bulletSize.x, 0)*0.5);
-		bullets.push_back(bullet);
+		return (count + chunkSize - 1) / chunkSize;
 	}
 
-protected:
-	int hp_;
-	int speed_;
-	float shootingSpeed_;
-	float timeFromLastBullet_;
-	Vector2f position_;
-	sf::Sprite sprite_;
-};
-
-class Enemy : public Spaceship
-{
-public:
-	Enemy(int hp, int speed, int startX, float shootingSpeed)
-		:Spaceship(hp, speed, Vector2f(startX, -10), shootingSpeed)
-	{ }
-
-	void update() override
+	// wywołuje function(kawałek, początek, koniec) dla kolejnych kawałków po chunkSize elementów
+	template <typename Function>
+	void parallelFor(int count, int chunkSize, Function function)
 	{
-		// poruszanie się statku
-		position_ += Vector2f(0, speed_) * deltaTime;
-
-		// liczenie czasu od poprzedniego wystrzału i strzelenie jeśli upłynęło go wystarczająco dużo
-		timeFromLastBullet_ += deltaTime;
-		if (timeFromLastBullet_ >= shootingSpeed_)
+		int chunksCount = getChunksCount(count, chunkSize);
+		if (chunksCount <= 1 || workers_.empty())
 		{
-			timeFromLastBullet_ = 0;
-			shoot(Direction::DOWN);
+			for (int chunk = 0; chunk < chunksCount; chunk++)
+				function(chunk, chunk * chunkSize, std::min(count, (chunk + 1) * chunkSize));
+			return;
 		}
-	}
-};
-std::vector<Enemy> enemys;
-
-class Player: public Spaceship
-{
-public:
-	Player()
-		:Spaceship(3, 200, Vector2f(400, 620), 0.8f)
-	{ }
 
-	void update() override
-	{
-		if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right) && position_.x < 950)
-			position_.x += speed_ * deltaTime;
-		if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left) && position_.x > 0)
-			position_.x -= speed_ * deltaTime;
+		FunctionJobBatch<Function> batch(function, count, chunkSize, chunksCount);
+		for (int chunk = 0; chunk < chunksCount; chunk++)
+		{
+			Job job = { &batch, chunk };
+			if (queues_[chunk % queues_.size()]->push(job))
+				pending_++;
+			else
+				runJob(job);
+		}
+		{
+			std::lock_guard<std::mutex> lock(wakeMutex_);
+		}
+		wake_.notify_all();
 
-		timeFromLastBullet_ += deltaTime;
-		if (timeFromLastBullet_ >= shootingSpeed_ && sf::Keyboard::isKeyPressed(sf::Keyboard::Up))
+		while (batch.remaining > 0)
 		{
-			timeFromLastBullet_ = 0;
-			shoot(Direction::UP);
+			Job job;
+			if (takeJob(0, job))
+				runJob(job);
+			else
+				std::this_thread::yield();
 		}
 	}
 
-	void draw()
+private:
+	void work(int index)
 	{
-		drawObject(getSprite(), getPostion());
+		while (true)
+		{
+			Job job;
+			if (takeJob(index, job))
+			{
+				runJob(job);
+				continue;
+			}
 
-		for (int i = 0; i < getHp(); i++)
-			drawObject(hpSprite_, Vector2f(10 + 25 * i, 670));
+			std::unique_lock<std::mutex> lock(wakeMutex_);
+			wake_.wait(lock, [&]() { return stopping_ || pending_ > 0; });
+			if (stopping_)
+				return;
+		}
 	}
 
-	void refillHp()
+	bool takeJob(int index, Job& job)
 	{
-		hp_ = 3;
+		int queuesCount = (int)queues_.size();
+		bool found = queues_[index]->popBack(job);
+		for (int i = 1; i < queuesCount && !found; i++)
+			found = queues_[(index + i) % queuesCount]->popFront(job);
+		if (found)
+			pending_--;
+		return found;
 	}
 
-	void setHpTexture(const std::string& hpTexture)
+	static void runJob(Job job)
 	{
-		hpSprite_.setTexture(textures[hpTexture]);
+		job.batch->run(job.chunk);
+		job.batch->remaining--;
 	}
 
-private:
-	sf::Sprite hpSprite_;
+	std::vector<std::unique_ptr<JobQueue>> queues_;
+	std::vector<std::thread> workers_;
+	std::mutex wakeMutex_;
+	std::condition_variable wake_;
+	bool stopping_;
+	std::atomic<int> pending_;
 };
-Player player;
+JobSystem jobs;
 
-class EnemyBuilder
+// wyniki zbierane osobno w każdym kawałku parallelFor i łączone potem w kolejności kawałków,
+// dzięki czemu efekty uboczne są stosowane w tej samej kolejności co w pętli szeregowej
+template <typename T>
+class ChunkResults
 {
 public:
-	EnemyBuilder(int hp, int speed, float shootingSpeed, const std::string& texture)
-		:hp_(hp), speed_(speed), shootingSpeed_(shootingSpeed), texture_(texture) 
-	{ }
-	
-	Enemy create(int startX)
+	// chunkCapacity to spodziewana największa liczba wyników kawałka; pojemność zostaje, więc kolejne klatki nie alokują
+	void reset(int chunksCount, int chunkCapacity)
+	{
+		if ((int)chunks_.size() < chunksCount)
+			chunks_.resize(chunksCount);
+		for (auto& chunk : chunks_)
+		{
+			chunk.clear();
+			chunk.reserve(chunkCapacity);
+		}
+	}
+
+	std::vector<T>& operator[](int chunk)
+	{
+		return chunks_[chunk];
+	}
+
+	template <typename Function>
+	void forEach(Function function)
 	{
-		Enemy enemy = Enemy(hp_, speed_, startX, shootingSpeed_);
-		enemy.setTexture(texture_);
-		return enemy;
-	} 
+		for (auto& chunk : chunks_)
+			for (auto& result : chunk)
+				function(result);
+	}
 
 private:
-	int hp_;
-	int speed_; 
-	float shootingSpeed_;
-	std::string texture_;
+	std::vector<std::vector<T>> chunks_;
 };
-std::vector<EnemyBuilder> builders_;
-
-void createEnemysBuilders()
-{
-	EnemyBuilder enemyNormal =   EnemyBuilder(30, 20, 3,   "enemy2");
-	EnemyBuilder enemyFastShot = EnemyBuilder(30, 25, 1.5, "enemy4");
-	EnemyBuilder enemyTank =     EnemyBuilder(60, 10, 4,   "enemy3");
-	EnemyBuilder enemySpecial =  EnemyBuilder(45, 22, 2.5, "enemy1");
-	EnemyBuilder enemyBoss =     EnemyBuilder(100, 8 , 3,   "enemy1-250");
 
-	builders_ = { enemyNormal, enemyFastShot, enemyTank, enemySpecial, enemyBoss };
-}
+// wrogowie są też przechowywani w kawałkach tej wielkości, więc kawałek zadania to jeden kawałek archetypu
+#define ENEMYS_CHUNK_SIZE 256
+#define BULLETS_CHUNK_SIZE 4096
 
-class LevelObjectInfo
+// numer obrazka w atlasie nadawany przy ładowaniu - gorące ścieżki (strzały, pojawianie się wrogów) nie szukają już tekstur po nazwie
+class TextureHandle
 {
 public:
-	LevelObjectInfo(EnemyBuilder& builder, int startX, float spawnTime)
-		:builder(builder), startX(startX), spawnTime(spawnTime) 
+	TextureHandle()
+		:index(-1)
 	{ }
-	
-	EnemyBuilder& builder;
-	int startX;
-	float spawnTime;
+
+	explicit TextureHandle(int index)
+		:index(index)
+	{ }
+
+	bool isValid() const
+	{
+		return index >= 0;
+	}
+
+	int index;
 };
 
-bool isSpriteClicked(const sf::Sprite& sprite)
+class AtlasRegion
 {
-	sf::Mouse mouse;
-	auto mousePosition = mouse.getPosition(window);
-	auto spritePosition = sprite.getPosition();
-	auto spriteSize = sprite.getTexture()->getSize();
+public:
+	AtlasRegion()
+		:page(0), rect()
+	{ }
 
-	return ((mousePosition.x >= spritePosition.x && mousePosition.x <= spritePosition.x + spriteSize.x) &&
-		(mousePosition.y >= spritePosition.y && mousePosition.y <= spritePosition.y + spriteSize.y));
-}
+	int page;
+	sf::IntRect rect;
+};
 
-class Button
+// maska kolizji: 1 bit na piksel (alfa >= 128). Każdy wiersz ma wordsPerRow słów 64-bitowych, w tym jedno zerowe
+// słowo zapasu, więc getBits() może czytać od dowolnej kolumny bez sprawdzania granic
+class AlphaMask
 {
 public:
-	Button(Vector2f position)
-		:position_(position), sprite_(), isClicked_(false), prevClicked_(false)
+	AlphaMask()
+		:width(0), height(0), wordsPerRow(0)
 	{ }
 
-	void update()
-	{
-		sf::Mouse mouse;
-		isClicked_ = isSpriteClicked(sprite_) && !mouse.isButtonPressed(sf::Mouse::Left) && prevClicked_;
-		prevClicked_ = mouse.isButtonPressed(sf::Mouse::Left);
-	}
-
-	bool isClicked()
+	void create(const sf::Image& image)
 	{
-		return isClicked_;
+		width = (int)image.getSize().x;
+		height = (int)image.getSize().y;
+		wordsPerRow = (width + 63) / 64 + 1;
+		bits.assign((size_t)wordsPerRow * height, 0);
+		const sf::Uint8* pixels = image.getPixelsPtr();
+		for (int row = 0; row < height; row++)
+			for (int column = 0; column < width; column++)
+				if (pixels[((size_t)row * width + column) * 4 + 3] >= 128)
+					bits[(size_t)row * wordsPerRow + column / 64] |= 1ull << (column % 64);
 	}
 
-	sf::Sprite& getSprite()
+	// maska zapisana wcześniej (paczka zasobów); words musi mieć wordsPerRow * height słów
+	void create(int maskWidth, int maskHeight, const std::uint64_t* words)
 	{
-		return sprite_;
+		width = maskWidth;
+		height = maskHeight;
+		wordsPerRow = (width + 63) / 64 + 1;
+		bits.assign(words, words + (size_t)wordsPerRow * height);
 	}
 
-	void setTexture(const std::string& texture)
+	bool isEmpty() const
 	{
-		sprite_.setTexture(textures[texture]);
+		return bits.empty();
 	}
 
-	Vector2f getPosition()
+	// 64 kolejne piksele wiersza od podanej kolumny; piksele poza obrazkiem są zerami
+	std::uint64_t getBits(int row, int column) const
 	{
-		return position_;
+		const std::uint64_t* words = &bits[(size_t)row * wordsPerRow + column / 64];
+		int shift = column % 64;
+		if (shift == 0)
+			return words[0];
+		return (words[0] >> shift) | (words[1] << (64 - shift));
 	}
 
-private:
-
-	Vector2f position_;
-	sf::Sprite sprite_;
-	bool isClicked_;
-	bool prevClicked_;
+	int width;
+	int height;
+	int wordsPerRow;
+	std::vector<std::uint64_t> bits;
 };
 
-enum class EMainMenuState
+// wszystkie obrazki z img/ są przy starcie pakowane w jedną lub dwie duże tekstury (strony),
+// dzięki czemu sprite'y z różnych obrazków mogą być rysowane jednym draw
+class TextureAtlas
 {
-	START_MENU,
-	LEVELS_MENU,
-	GAME_OVER,
-	LEVEL_PASSED,
-	NO_MENU
-};
-
-void loadLevel1();
-void loadLevel2();
-void loadLevel3();
+#define ATLAS_PAGE_SIZE 2048
+#define ATLAS_PADDING 1
 
-class MainMenu
-{
 public:
-	MainMenu()
-		:startButton_(Vector2f(350, 250)), exitButton_(Vector2f(350, 350)), level1Button_(Vector2f(350, 200)),
-		level2Button_(Vector2f(350, 300)), level3Button_(Vector2f(350, 400)), exit2Button_(Vector2f(350, 500)), menuState_(EMainMenuState::NO_MENU)
-	{ }
-
-	void setButtonsTextures()
+	// obrazek jest tylko zapamiętywany - dekodowanie odbywa się w build()
+	TextureHandle addImage(const std::string& name, const std::string& path)
 	{
-		startButton_.setTexture("start_button");
-		exitButton_.setTexture("exit_button");
-		level1Button_.setTexture("level1_button");
-		level2Button_.setTexture("level2_button");
-		level3Button_.setTexture("level3_button");
-		exit2Button_.setTexture("exit_button");
-		levelPassed_.setTexture(textures["level_passed"]);
-		gameOver_.setTexture(textures["game_over"]);
+		TextureHandle handle((int)regions_.size());
+		regions_.push_back(AtlasRegion());
+		paths_.push_back(path);
+		names_[name] = handle;
+
+		pending_.push_back(PendingImage());
+		pending_.back().handle = handle;
+		pending_.back().path = path;
+		return handle;
 	}
 
-	void update()
+	// dekoduje obrazki (równolegle, jeśli parallel), rozkłada je na stronach i (jeśli createTextures) wysyła strony na kartę graficzną;
+	// pageImages, jeśli podane, dostaje złożone strony (do zapisu paczki zasobów)
+	void build(bool createTextures, bool parallel, std::vector<sf::Image>* pageImages = nullptr)
 	{
-		startButton_.update();
-		exitButton_.update();
-		level1Button_.update();
-		level2Button_.update();
-		level3Button_.update();
-		exit2Button_.update();
-
-		if (menuState_ == EMainMenuState::START_MENU)
+		auto decode = [this](int index)
 		{
-			if (startButton_.isClicked())
-				menuState_ = EMainMenuState::LEVELS_MENU;
-			if (exitButton_.isClicked())
-				exit(0);
-		}
-		else if (menuState_ == EMainMenuState::LEVELS_MENU)
+			PendingImage& pending = pending_[index];
+			if (!pending.image.loadFromFile(pending.path))
+				std::cerr << "cannot load " << pending.path << std::endl;
+			pending.region.rect = sf::IntRect(0, 0, pending.image.getSize().x, pending.image.getSize().y);
+			if (pending.image.getPixelsPtr() != nullptr)
+				pending.mask.create(pending.image);
+		};
+		if (parallel)
+			runInParallel((int)pending_.size(), decode);
+		else
+			for (int i = 0; i < (int)pending_.size(); i++)
+				decode(i);
+
+		unsigned pageSize = ATLAS_PAGE_SIZE;
+		if (createTextures)
+			pageSize = std::min(pageSize, sf::Texture::getMaximumSize());
+
+		std::vector<sf::Vector2u> pageSizes = layout(pageSize);
+		masks_.resize(regions_.size());
+		for (auto& pending : pending_)
 		{
-			if (level1Button_.isClicked())
-			{
-				loadLevel1();
-				menuState_ = EMainMenuState::NO_MENU;
-			}
-			else if (level2Button_.isClicked())
-			{
-				loadLevel2();
-				menuState_ = EMainMenuState::NO_MENU;
-			}
-			else if (level3Button_.isClicked())
-			{
-				loadLevel3();
-				menuState_ = EMainMenuState::NO_MENU;
-			}
-			else if (exit2Button_.isClicked())
-			{
-				menuState_ = EMainMenuState::START_MENU;
-			}
+			regions_[pending.handle.index] = pending.region;
+			masks_[pending.handle.index] = std::move(pending.mask);
 		}
-		else if (menuState_ == EMainMenuState::GAME_OVER || menuState_ == EMainMenuState::LEVEL_PASSED)
+
+		if (createTextures || pageImages != nullptr)
 		{
-			endSceeenTimer_ -= deltaTime;
-			if (endSceeenTimer_ <= 0)
+			for (size_t page = 0; page < pageSizes.size(); page++)
 			{
-				setMenuState(EMainMenuState::LEVELS_MENU);
+				sf::Image pageImage;
+				pageImage.create(pageSizes[page].x, pageSizes[page].y, sf::Color::Transparent);
+				for (auto& pending : pending_)
+					if (pending.region.page == (int)page)
+						pageImage.copy(pending.image, pending.region.rect.left, pending.region.rect.top);
+
+				if (createTextures)
+				{
+					pages_.push_back(std::make_unique<sf::Texture>());
+					pages_.back()->loadFromImage(pageImage);
+				}
+				if (pageImages != nullptr)
+					pageImages->push_back(std::move(pageImage));
 			}
 		}
+		pending_.clear();
 	}
 
-	void draw()
+	// strona z gotowych pikseli RGBA (z paczki zasobów) - tekstura powstaje bez dekodowania i bez kopii w sf::Image
+	void addPage(unsigned width, unsigned height, const sf::Uint8* pixels, bool createTexture)
 	{
-		if (menuState_ == EMainMenuState::START_MENU)
-		{
-			drawObject(startButton_.getSprite(), startButton_.getPosition());
-			drawObject(exitButton_.getSprite(), exitButton_.getPosition());
+		if (!createTexture)
+			return;
+		pages_.push_back(std::make_unique<sf::Texture>());
+		if (pages_.back()->create(width, height))
+			pages_.back()->update(pixels);
+	}
+
+	// obrazek już rozłożony na stronie dodanej przez addPage()
+	TextureHandle addRegion(const std::string& name, const std::string& path, const AtlasRegion& region, AlphaMask& mask)
+	{
+		TextureHandle handle((int)regions_.size());
+		regions_.push_back(region);
+		paths_.push_back(path);
+		masks_.push_back(std::move(mask));
+		names_[name] = handle;
+		return handle;
+	}
+
+	// tylko do użytku przy ładowaniu; nieznana nazwa daje nieważny uchwyt zamiast pustej tekstury
+	TextureHandle find(const std::string& name)
+	{
+		auto handle = names_.find(name);
+		if (handle == names_.end())
+		{
+			std::cerr << "unknown texture " << name << std::endl;
+			return TextureHandle();
+		}
+		return handle->second;
+	}
+
+	const AtlasRegion& getRegion(TextureHandle handle)
+	{
+		return regions_[handle.index];
+	}
+
+	sf::Texture& getPage(int page)
+	{
+		return *pages_[page];
+	}
+
+	// obrazek wczytany z podanej ścieżki albo nieważny uchwyt; ścieżki nie zmieniają się po build(), więc można pytać z innego wątku
+	TextureHandle findPath(const std::string& path) const
+	{
+		for (size_t index = 0; index < paths_.size(); index++)
+			if (paths_[index] == path)
+				return TextureHandle((int)index);
+		return TextureHandle();
+	}
+
+	const std::string& getPath(TextureHandle handle)
+	{
+		return paths_[handle.index];
+	}
+
+	const std::vector<std::string>& getPaths()
+	{
+		return paths_;
+	}
+
+	std::string getName(TextureHandle handle)
+	{
+		for (auto& name : names_)
+			if (name.second.index == handle.index)
+				return name.first;
+		return std::string();
+	}
+
+	int getImagesCount()
+	{
+		return (int)regions_.size();
+	}
+
+	// podmienia obrazek po build(); obiekty sf::Texture stron nie są usuwane, więc wskaźniki w sprite'ach pozostają ważne.
+	// Obrazek o tym samym rozmiarze jest nadpisywany na swojej stronie, inny rozmiar dostaje własną stronę - przy kolejnych
+	// zmianach ta sama strona jest używana ponownie (i w razie potrzeby powiększana), więc stron przybywa najwyżej tyle, ile jest obrazków.
+	void replaceImage(TextureHandle handle, const sf::Image& image, AlphaMask& mask)
+	{
+		AtlasRegion& region = regions_[handle.index];
+		sf::Vector2u size = image.getSize();
+		if ((int)size.x == region.rect.width && (int)size.y == region.rect.height)
+		{
+			pages_[region.page]->update(image, region.rect.left, region.rect.top);
+		}
+		else
+		{
+			if (!isOwnPage(handle))
+			{
+				pages_.push_back(std::make_unique<sf::Texture>());
+				region.page = (int)pages_.size() - 1;
+			}
+			sf::Texture& page = *pages_[region.page];
+			if (page.getSize().x < size.x || page.getSize().y < size.y)
+				page.create(std::max(page.getSize().x, size.x), std::max(page.getSize().y, size.y));
+			page.update(image, 0, 0);
+			region.rect = sf::IntRect(0, 0, size.x, size.y);
+		}
+		masks_[handle.index] = std::move(mask);
+	}
+
+	// pusta maska dla nieważnego uchwytu albo obrazka, którego nie udało się wczytać
+	const AlphaMask& getMask(TextureHandle handle)
+	{
+		static const AlphaMask empty;
+		return handle.isValid() ? masks_[handle.index] : empty;
+	}
+
+private:
+	class PendingImage
+	{
+	public:
+		TextureHandle handle;
+		std::string path;
+		sf::Image image;
+		AtlasRegion region;
+		AlphaMask mask;
+	};
+
+	// pakowanie półkowe: obrazki od najwyższego układane są w rzędach, nowa strona gdy obecna się zapełni
+	std::vector<sf::Vector2u> layout(unsigned pageSize)
+	{
+		std::vector<PendingImage*> order;
+		for (auto& pending : pending_)
+			order.push_back(&pending);
+		std::stable_sort(order.begin(), order.end(), [](PendingImage* a, PendingImage* b)
+		{
+			return a->region.rect.height > b->region.rect.height;
+		});
+
+		std::vector<sf::Vector2u> pageSizes(1, sf::Vector2u(0, 0));
+		unsigned x = 0, y = 0, shelfHeight = 0;
+		for (PendingImage* pending : order)
+		{
+			sf::IntRect& rect = pending->region.rect;
+			if (x + rect.width > pageSize)
+			{
+				x = 0;
+				y += shelfHeight + ATLAS_PADDING;
+				shelfHeight = 0;
+			}
+			if (y + rect.height > pageSize)
+			{
+				pageSizes.push_back(sf::Vector2u(0, 0));
+				x = y = shelfHeight = 0;
+			}
+
+			pending->region.page = (int)pageSizes.size() - 1;
+			rect.left = x;
+			rect.top = y;
+			x += rect.width + ATLAS_PADDING;
+			shelfHeight = std::max(shelfHeight, (unsigned)rect.height);
+
+			sf::Vector2u& used = pageSizes.back();
+			used.x = std::max(used.x, (unsigned)(rect.left + rect.width));
+			used.y = std::max(used.y, (unsigned)(rect.top + rect.height));
+		}
+		return pageSizes;
+	}
+
+	// strona, na której nie leży żaden inny obrazek (własna strona z replaceImage())
+	bool isOwnPage(TextureHandle handle)
+	{
+		int page = regions_[handle.index].page;
+		for (size_t index = 0; index < regions_.size(); index++)
+			if ((int)index != handle.index && regions_[index].page == page)
+				return false;
+		return true;
+	}
+
+	std::vector<PendingImage> pending_;
+	std::vector<AtlasRegion> regions_;
+	std::vector<std::string> paths_;
+	std::vector<AlphaMask> masks_;
+	std::unordered_map<std::string, TextureHandle> names_;
+	std::vector<std::unique_ptr<sf::Texture>> pages_;
+};
+TextureAtlas atlas;
+
+// zbiera sprite'y w jedną tablicę czworokątów na teksturę i rysuje każdą z nich jednym wywołaniem draw
+class SpriteBatch
+{
+public:
+	void add(const sf::Sprite& sprite, Vector2f position)
+	{
+		add(sprite.getTexture(), sprite.getTextureRect(), position);
+	}
+
+	void add(const sf::Texture* texture, const sf::IntRect& rect, Vector2f position)
+	{
+		if (texture == nullptr)
+			return;
+
+		float right = position.x + rect.width;
+		float bottom = position.y + rect.height;
+		float textureRight = (float)(rect.left + rect.width);
+		float textureBottom = (float)(rect.top + rect.height);
+
+		sf::VertexArray& vertices = getVertices(texture);
+		vertices.append(sf::Vertex(sf::Vector2f(position.x, position.y), sf::Vector2f((float)rect.left, (float)rect.top)));
+		vertices.append(sf::Vertex(sf::Vector2f(right, position.y), sf::Vector2f(textureRight, (float)rect.top)));
+		vertices.append(sf::Vertex(sf::Vector2f(right, bottom), sf::Vector2f(textureRight, textureBottom)));
+		vertices.append(sf::Vertex(sf::Vector2f(position.x, bottom), sf::Vector2f((float)rect.left, textureBottom)));
+	}
+
+	// rysuje wszystko, co zebrano od poprzedniego wywołania - jedna warstwa to jedno draw na teksturę
+	void draw(sf::RenderTarget& target)
+	{
+		for (auto& batch : batches_)
+		{
+			if (batch.vertices.getVertexCount() == 0)
+				continue;
+			target.draw(batch.vertices, sf::RenderStates(batch.texture));
+			batch.vertices.clear();
+		}
+	}
+
+private:
+	class Batch
+	{
+	public:
+		Batch(const sf::Texture* texture)
+			:texture(texture), vertices(sf::Quads)
+		{ }
+
+		const sf::Texture* texture;
+		sf::VertexArray vertices;
+	};
+
+	sf::VertexArray& getVertices(const sf::Texture* texture)
+	{
+		// tekstur jest kilkanaście, więc wystarczy przeszukanie liniowe
+		for (auto& batch : batches_)
+			if (batch.texture == texture)
+				return batch.vertices;
+		batches_.push_back(Batch(texture));
+		return batches_.back().vertices;
+	}
+
+	std::vector<Batch> batches_;
+};
+SpriteBatch spriteBatch;
+
+void drawObject(const sf::Sprite& sprite, Vector2f objectPosition)
+{
+	spriteBatch.add(sprite, objectPosition);
+}
+
+// bez okna nie ma kontekstu OpenGL, więc w trybie headless tekstury nie istnieją - symulacja potrzebuje tylko ich rozmiarów
+void setSpriteTexture(sf::Sprite& sprite, sf::Vector2u& size, TextureHandle texture)
+{
+	if (!texture.isValid())
+		return;
+
+	const AtlasRegion& region = atlas.getRegion(texture);
+	size = sf::Vector2u(region.rect.width, region.rect.height);
+	if (!headless)
+	{
+		sprite.setTexture(atlas.getPage(region.page));
+		sprite.setTextureRect(region.rect);
+	}
+}
+
+void setSpriteTexture(sf::Sprite& sprite, const std::string& texture)
+{
+	sf::Vector2u size;
+	setSpriteTexture(sprite, size, atlas.find(texture));
+}
+
+// liczba prostokątów sprawdzanych naraz przez collideBlock()
+#define COLLISION_BLOCK 8
+
+// pociski jednego kierunku trzymane jako osobne tablice współrzędnych o stałej pojemności;
+// wszystkie mają tę samą teksturę, więc wystarczy jeden sprite do rysowania
+class BulletLane
+{
+#define BULLET_SPEED 200
+#define BULLET_LANE_CAPACITY 65536
+// pociski tak daleko za planszą nie mogą już w nic trafić (wrogowie pojawiają się najwyżej ~135 px nad ekranem)
+#define BULLET_CULL_MARGIN 300
+
+public:
+	BulletLane(Direction direction)
+		:direction_(direction), x_(BULLET_LANE_CAPACITY + COLLISION_BLOCK), y_(BULLET_LANE_CAPACITY + COLLISION_BLOCK), prevY_(BULLET_LANE_CAPACITY), alive_(BULLET_LANE_CAPACITY), count_(0)
+	{ }
+
+	void setTexture(const std::string& texture)
+	{
+		texture_ = atlas.find(texture);
+		setSpriteTexture(sprite_, size_, texture_);
+	}
+
+	TextureHandle getTexture()
+	{
+		return texture_;
+	}
+
+	// O(1); gdy pula jest pełna, strzał przepada
+	bool spawn(float x, float y)
+	{
+		if (count_ == BULLET_LANE_CAPACITY)
+			return false;
+
+		x_[count_] = x;
+		y_[count_] = y;
+		prevY_[count_] = y;
+		alive_[count_] = 1;
+		count_++;
+		return true;
+	}
+
+	void kill(int index)
+	{
+		alive_[index] = 0;
+	}
+
+	void update()
+	{
+		// usuwanie martwych pocisków przez przeniesienie ostatniego na ich miejsce
+		for (int i = 0; i < count_; i++)
+		{
+			bool outside = (direction_ == Direction::UP) ? y_[i] < -BULLET_CULL_MARGIN : y_[i] > 700 + BULLET_CULL_MARGIN;
+			if (!alive_[i] || outside)
+			{
+				count_--;
+				x_[i] = x_[count_];
+				y_[i] = y_[count_];
+				prevY_[i] = prevY_[count_];
+				alive_[i] = alive_[count_];
+				i--;
+			}
+		}
+
+		// poruszanie się pocisków
+		float step = (float)((direction_ == Direction::DOWN) ? BULLET_SPEED : -BULLET_SPEED) * deltaTime;
+		float* y = y_.data();
+		float* prevY = prevY_.data();
+		jobs.parallelFor(count_, BULLETS_CHUNK_SIZE, [=](int, int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+			{
+				prevY[i] = y[i];
+				y[i] += step;
+			}
+		});
+	}
+
+	void clear()
+	{
+		count_ = 0;
+	}
+
+	// żywe pociski pasa; zapisywane są tylko pierwsze count_ elementów tablic
+	class State
+	{
+	public:
+		State()
+			:count(0)
+		{ }
+
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> prevY;
+		std::vector<unsigned char> alive;
+		int count;
+	};
+
+	void save(State& state)
+	{
+		state.x.assign(x_.begin(), x_.begin() + count_);
+		state.y.assign(y_.begin(), y_.begin() + count_);
+		state.prevY.assign(prevY_.begin(), prevY_.begin() + count_);
+		state.alive.assign(alive_.begin(), alive_.begin() + count_);
+		state.count = count_;
+	}
+
+	void restore(const State& state)
+	{
+		std::copy(state.x.begin(), state.x.end(), x_.begin());
+		std::copy(state.y.begin(), state.y.end(), y_.begin());
+		std::copy(state.prevY.begin(), state.prevY.end(), prevY_.begin());
+		std::copy(state.alive.begin(), state.alive.end(), alive_.begin());
+		count_ = state.count;
+	}
+
+	int size()
+	{
+		return count_;
+	}
+
+	bool isAlive(int index)
+	{
+		return alive_[index] != 0;
+	}
+
+	Vector2f getPosition(int index)
+	{
+		return Vector2f(x_[index], y_[index]);
+	}
+
+	// tablice współrzędnych mają COLLISION_BLOCK elementów zapasu, więc blok testu kolizji może wyjść za count_
+	const float* getX()
+	{
+		return x_.data();
+	}
+
+	const float* getY()
+	{
+		return y_.data();
+	}
+
+	Vector2f getInterpolatedPosition(int index, float alpha)
+	{
+		return Vector2f(x_[index], prevY_[index] + (y_[index] - prevY_[index]) * alpha);
+	}
+
+	sf::Vector2u getSize()
+	{
+		return size_;
+	}
+
+	sf::Sprite& getSprite()
+	{
+		return sprite_;
+	}
+
+	Direction getDirection()
+	{
+		return direction_;
+	}
+
+private:
+	Direction direction_;
+	std::vector<float> x_;
+	std::vector<float> y_;
+	std::vector<float> prevY_;
+	std::vector<unsigned char> alive_;
+	int count_;
+	sf::Sprite sprite_;
+	TextureHandle texture_;
+	sf::Vector2u size_;
+};
+
+// osobne pasy dla pocisków gracza (lecą w górę) i wrogów (lecą w dół)
+class BulletPool
+{
+public:
+	BulletPool()
+		:playerBullets(Direction::UP), enemyBullets(Direction::DOWN)
+	{ }
+
+	void setTextures()
+	{
+		playerBullets.setTexture("bullet_green");
+		enemyBullets.setTexture("bullet_red");
+	}
+
+	BulletLane& getLane(Direction direction)
+	{
+		return (direction == Direction::UP) ? playerBullets : enemyBullets;
+	}
+
+	// position to środek dolnej (lub górnej) krawędzi pocisku
+	void spawn(Vector2f position, Direction direction)
+	{
+		BulletLane& lane = getLane(direction);
+		lane.spawn(position.x - (float)lane.getSize().x * 0.5f, position.y);
+	}
+
+	void update()
+	{
+		playerBullets.update();
+		enemyBullets.update();
+	}
+
+	void clear()
+	{
+		playerBullets.clear();
+		enemyBullets.clear();
+	}
+
+	size_t size()
+	{
+		return playerBullets.size() + enemyBullets.size();
+	}
+
+	BulletLane playerBullets;
+	BulletLane enemyBullets;
+};
+BulletPool bullets;
+
+class Spaceship
+{
+public:
+	Spaceship(int hp, int speed, Vector2f position, float shootingSpeed)
+		:hp_(hp), hpVersion_(0), speed_(speed), shootingSpeed_(shootingSpeed), timeFromLastBullet_(0), position_(position), prevPosition_(position)
+	{ }
+
+	sf::Sprite& getSprite()
+	{
+		return sprite_;
+	}
+
+	void setTexture(TextureHandle texture)
+	{
+		texture_ = texture;
+		setSpriteTexture(sprite_, size_, texture);
+	}
+
+	TextureHandle getTexture()
+	{
+		return texture_;
+	}
+
+	void setTexture(const std::string& texture)
+	{
+		setTexture(atlas.find(texture));
+	}
+
+	void setPosition(Vector2f position)
+	{
+		position_ = position;
+		prevPosition_ = position;
+	}
+
+	Vector2f getSize()
+	{
+		return Vector2f(size_.x, size_.y);
+	}
+
+	Vector2f getPostion()
+	{
+		return position_;
+	}
+
+	// pozycja do narysowania pomiędzy dwoma krokami symulacji (alpha 0 - poprzedni krok, 1 - obecny)
+	Vector2f getInterpolatedPosition(float alpha)
+	{
+		return prevPosition_ + (position_ - prevPosition_) * alpha;
+	}
+
+	int getHp()
+	{
+		return hp_;
+	}
+
+	// zmienia się razem z hp_; warstwa HUD jest rysowana od nowa tylko po zmianie
+	std::uint32_t getHpVersion()
+	{
+		return hpVersion_;
+	}
+
+	float getTimeFromLastBullet()
+	{
+		return timeFromLastBullet_;
+	}
+
+	void restoreState(Vector2f position, int hp, float timeFromLastBullet)
+	{
+		setPosition(position);
+		hp_ = hp;
+		hpVersion_++;
+		timeFromLastBullet_ = timeFromLastBullet;
+	}
+
+	void takeDamage(int damage)
+	{
+		hp_ -= damage;
+		if (hp_ <= 0)
+			hp_ = 0;
+		hpVersion_++;
+	}
+
+	void shoot(Direction direction)
+	{
+		auto size = getSize();
+		bullets.spawn(position_ + Vector2f(size.x, (direction == Direction::DOWN) ? size.y : -(float)size.y)*0.5, direction);
+	}
+
+protected:
+	int hp_;
+	std::uint32_t hpVersion_;
+	int speed_;
+	float shootingSpeed_;
+	float timeFromLastBullet_;
+	Vector2f position_;
+	Vector2f prevPosition_;
+	sf::Sprite sprite_;
+	TextureHandle texture_;
+	sf::Vector2u size_;
+};
+
+// uchwyt wroga, który pozostaje ważny, gdy inni wrogowie są usuwani i przesuwani w pamięci;
+// generacja odróżnia usuniętego wroga od nowego, który zajął jego miejsce w tabeli uchwytów
+class EntityHandle
+{
+public:
+	EntityHandle()
+		:index(-1), generation(0)
+	{ }
+
+	EntityHandle(int index, std::uint32_t generation)
+		:index(index), generation(generation)
+	{ }
+
+	int index;
+	std::uint32_t generation;
+};
+
+// komponenty ENEMYS_CHUNK_SIZE wrogów, każdy jako osobna tablica: pozycja, prędkość, zdrowie, broń i tekstura
+class EnemyChunk
+{
+public:
+	float x[ENEMYS_CHUNK_SIZE];
+	float y[ENEMYS_CHUNK_SIZE];
+	float prevY[ENEMYS_CHUNK_SIZE];
+	float speed[ENEMYS_CHUNK_SIZE];
+	int hp[ENEMYS_CHUNK_SIZE];
+	float shootingSpeed[ENEMYS_CHUNK_SIZE];
+	float timeFromLastBullet[ENEMYS_CHUNK_SIZE];
+	TextureHandle texture[ENEMYS_CHUNK_SIZE];
+	sf::Vector2u size[ENEMYS_CHUNK_SIZE];
+	EntityHandle handle[ENEMYS_CHUNK_SIZE];
+};
+
+// archetyp wroga: wrogowie są upakowani gęsto (wszystkie kawałki poza ostatnim są pełne), więc wróg o indeksie i
+// leży w kawałku i / ENEMYS_CHUNK_SIZE. Usunięcie przenosi ostatniego wroga na zwolnione miejsce i poprawia jego wpis
+// w tabeli uchwytów. Indeksy są ważne w obrębie jednej fazy, a między klatkami wroga wskazuje EntityHandle.
+class EnemyStore
+{
+	// wpis tabeli uchwytów; zdefiniowany na początku, bo korzysta z niego EnemyStore::State
+	class HandleSlot
+	{
+	public:
+		HandleSlot()
+			:generation(0), index(0)
+		{ }
+
+		std::uint32_t generation;
+		// indeks wroga, a dla wolnego wpisu - następny wolny wpis
+		int index;
+	};
+
+public:
+	EnemyStore()
+		:count_(0), firstFree_(-1)
+	{ }
+
+	int size()
+	{
+		return count_;
+	}
+
+	// przydziela z góry kawałki i tabelę uchwytów dla count wrogów, żeby pojawianie się wrogów nie alokowało pamięci
+	void reserve(int count)
+	{
+		while ((int)chunks_.size() * ENEMYS_CHUNK_SIZE < count)
+			chunks_.push_back(std::unique_ptr<EnemyChunk>(new EnemyChunk()));
+		slots_.reserve(count);
+	}
+
+	EntityHandle add(int hp, int speed, Vector2f position, float shootingSpeed, TextureHandle texture)
+	{
+		if (count_ == (int)chunks_.size() * ENEMYS_CHUNK_SIZE)
+			chunks_.push_back(std::unique_ptr<EnemyChunk>(new EnemyChunk()));
+
+		int slot = firstFree_;
+		if (slot >= 0)
+		{
+			firstFree_ = slots_[slot].index;
+		}
+		else
+		{
+			slot = (int)slots_.size();
+			slots_.push_back(HandleSlot());
+		}
+		int index = count_++;
+		slots_[slot].index = index;
+
+		EnemyChunk& chunk = getChunk(index / ENEMYS_CHUNK_SIZE);
+		int i = index % ENEMYS_CHUNK_SIZE;
+		chunk.x[i] = position.x;
+		chunk.y[i] = position.y;
+		chunk.prevY[i] = position.y;
+		chunk.speed[i] = (float)speed;
+		chunk.hp[i] = hp;
+		chunk.shootingSpeed[i] = shootingSpeed;
+		chunk.timeFromLastBullet[i] = 0;
+		chunk.texture[i] = texture;
+		chunk.size[i] = texture.isValid() ? sf::Vector2u(atlas.getRegion(texture).rect.width, atlas.getRegion(texture).rect.height) : sf::Vector2u();
+		chunk.handle[i] = EntityHandle(slot, slots_[slot].generation);
+		return chunk.handle[i];
+	}
+
+	// O(1) - na miejsce usuniętego trafia ostatni wróg
+	void remove(int index)
+	{
+		EnemyChunk& chunk = getChunk(index / ENEMYS_CHUNK_SIZE);
+		int i = index % ENEMYS_CHUNK_SIZE;
+		freeSlot(chunk.handle[i].index);
+
+		count_--;
+		if (index == count_)
+			return;
+		EnemyChunk& last = getChunk(count_ / ENEMYS_CHUNK_SIZE);
+		int j = count_ % ENEMYS_CHUNK_SIZE;
+		chunk.x[i] = last.x[j];
+		chunk.y[i] = last.y[j];
+		chunk.prevY[i] = last.prevY[j];
+		chunk.speed[i] = last.speed[j];
+		chunk.hp[i] = last.hp[j];
+		chunk.shootingSpeed[i] = last.shootingSpeed[j];
+		chunk.timeFromLastBullet[i] = last.timeFromLastBullet[j];
+		chunk.texture[i] = last.texture[j];
+		chunk.size[i] = last.size[j];
+		chunk.handle[i] = last.handle[j];
+		slots_[chunk.handle[i].index].index = index;
+	}
+
+	// usuwa wrogów, dla których predicate(kawałek, miejsce) zwraca true, w tej samej kolejności co pętla z remove(i) i i--;
+	// zwraca liczbę usuniętych
+	template <typename Predicate>
+	int removeIf(Predicate predicate)
+	{
+		int removed = 0;
+		for (int first = 0; first < count_; first += ENEMYS_CHUNK_SIZE)
+		{
+			EnemyChunk& chunk = getChunk(first / ENEMYS_CHUNK_SIZE);
+			int chunkCount = std::min(ENEMYS_CHUNK_SIZE, count_ - first);
+			for (int i = 0; i < chunkCount;)
+			{
+				if (!predicate(chunk, i))
+				{
+					i++;
+					continue;
+				}
+				remove(first + i);
+				removed++;
+				chunkCount = std::min(ENEMYS_CHUNK_SIZE, count_ - first);
+			}
+		}
+		return removed;
+	}
+
+	// kopia zajętych kawałków i tabeli uchwytów - uchwyty wydane przed zapisem są po przywróceniu znowu ważne
+	class State
+	{
+	public:
+		State()
+			:count(0), firstFree(-1)
+		{ }
+
+		std::vector<EnemyChunk> chunks;
+		std::vector<HandleSlot> slots;
+		int count;
+		int firstFree;
+	};
+
+	void save(State& state)
+	{
+		int chunksCount = (count_ + ENEMYS_CHUNK_SIZE - 1) / ENEMYS_CHUNK_SIZE;
+		state.chunks.resize(chunksCount);
+		for (int chunk = 0; chunk < chunksCount; chunk++)
+			state.chunks[chunk] = *chunks_[chunk];
+		state.slots = slots_;
+		state.count = count_;
+		state.firstFree = firstFree_;
+	}
+
+	void restore(const State& state)
+	{
+		reserve(state.count);
+		for (size_t chunk = 0; chunk < state.chunks.size(); chunk++)
+			*chunks_[chunk] = state.chunks[chunk];
+		slots_ = state.slots;
+		count_ = state.count;
+		firstFree_ = state.firstFree;
+	}
+
+	// po podmianie obrazków w atlasie
+	void updateSizes()
+	{
+		for (int index = 0; index < count_; index++)
+		{
+			EnemyChunk& chunk = getChunk(index / ENEMYS_CHUNK_SIZE);
+			int i = index % ENEMYS_CHUNK_SIZE;
+			if (chunk.texture[i].isValid())
+				chunk.size[i] = sf::Vector2u(atlas.getRegion(chunk.texture[i]).rect.width, atlas.getRegion(chunk.texture[i]).rect.height);
+		}
+	}
+
+	// kawałki zostają zaalokowane na następny poziom
+	void clear()
+	{
+		for (int index = 0; index < count_; index++)
+			freeSlot(getChunk(index / ENEMYS_CHUNK_SIZE).handle[index % ENEMYS_CHUNK_SIZE].index);
+		count_ = 0;
+	}
+
+	// indeks wroga albo -1, gdy został już usunięty
+	int find(EntityHandle handle)
+	{
+		if (handle.index < 0 || handle.index >= (int)slots_.size() || slots_[handle.index].generation != handle.generation)
+			return -1;
+		return slots_[handle.index].index;
+	}
+
+	EnemyChunk& getChunk(int chunk)
+	{
+		return *chunks_[chunk];
+	}
+
+	Vector2f getPosition(int index)
+	{
+		EnemyChunk& chunk = getChunk(index / ENEMYS_CHUNK_SIZE);
+		return Vector2f(chunk.x[index % ENEMYS_CHUNK_SIZE], chunk.y[index % ENEMYS_CHUNK_SIZE]);
+	}
+
+	// wrogowie poruszają się tylko w pionie
+	Vector2f getPrevPosition(int index)
+	{
+		EnemyChunk& chunk = getChunk(index / ENEMYS_CHUNK_SIZE);
+		return Vector2f(chunk.x[index % ENEMYS_CHUNK_SIZE], chunk.prevY[index % ENEMYS_CHUNK_SIZE]);
+	}
+
+	void setPosition(int index, Vector2f position)
+	{
+		EnemyChunk& chunk = getChunk(index / ENEMYS_CHUNK_SIZE);
+		chunk.x[index % ENEMYS_CHUNK_SIZE] = position.x;
+		chunk.y[index % ENEMYS_CHUNK_SIZE] = position.y;
+		chunk.prevY[index % ENEMYS_CHUNK_SIZE] = position.y;
+	}
+
+	Vector2f getSize(int index)
+	{
+		sf::Vector2u size = getChunk(index / ENEMYS_CHUNK_SIZE).size[index % ENEMYS_CHUNK_SIZE];
+		return Vector2f(size.x, size.y);
+	}
+
+	int getHp(int index)
+	{
+		return getChunk(index / ENEMYS_CHUNK_SIZE).hp[index % ENEMYS_CHUNK_SIZE];
+	}
+
+	float getTimeFromLastBullet(int index)
+	{
+		return getChunk(index / ENEMYS_CHUNK_SIZE).timeFromLastBullet[index % ENEMYS_CHUNK_SIZE];
+	}
+
+	TextureHandle getTexture(int index)
+	{
+		return getChunk(index / ENEMYS_CHUNK_SIZE).texture[index % ENEMYS_CHUNK_SIZE];
+	}
+
+	void takeDamage(int index, int damage)
+	{
+		int& hp = getChunk(index / ENEMYS_CHUNK_SIZE).hp[index % ENEMYS_CHUNK_SIZE];
+		hp -= damage;
+		if (hp <= 0)
+			hp = 0;
+	}
+
+	void shoot(int index)
+	{
+		auto size = getSize(index);
+		bullets.spawn(getPosition(index) + Vector2f(size.x, size.y)*0.5, Direction::DOWN);
+	}
+
+private:
+	void freeSlot(int slot)
+	{
+		slots_[slot].generation++;
+		slots_[slot].index = firstFree_;
+		firstFree_ = slot;
+	}
+
+	std::vector<std::unique_ptr<EnemyChunk>> chunks_;
+	int count_;
+	std::vector<HandleSlot> slots_;
+	int firstFree_;
+};
+EnemyStore enemys;
+
+// stan wejścia w jednym kroku symulacji - jedyne, co gracz może zmienić w przebiegu gry, więc to on jest nagrywany
+class InputState
+{
+public:
+	InputState()
+		:left(false), right(false), shoot(false), mouseLeft(false), mouseX(0), mouseY(0)
+	{ }
+
+	bool left;
+	bool right;
+	bool shoot;
+	bool mouseLeft;
+	int mouseX;
+	int mouseY;
+};
+
+// źródło wejścia - klawiatura i mysz w normalnej grze, bot w trybie headless, nagranie przy odtwarzaniu
+class InputSource
+{
+public:
+	virtual ~InputSource() { }
+
+	virtual InputState read() = 0;
+};
+
+// stan klawiatury i myszy składany ze zdarzeń z pollEvent() zamiast odpytywania urządzeń w każdej klatce;
+// naciśnięcie puszczone przed read() jest zwracane jeszcze raz, więc klik krótszy niż klatka nie ginie
+class DeviceInput : public InputSource
+{
+public:
+	DeviceInput()
+		:held_(), pressed_(), firstEventTime_(-1), latency_(0)
+	{ }
+
+	void handleEvent(const sf::Event& event)
+	{
+		sf::Int64 time = clock_.getElapsedTime().asMicroseconds();
+		bool handled = true;
+		if (event.type == sf::Event::KeyPressed || event.type == sf::Event::KeyReleased)
+		{
+			bool down = event.type == sf::Event::KeyPressed;
+			if (event.key.code == sf::Keyboard::Left)
+				setButton(held_.left, pressed_.left, down);
+			else if (event.key.code == sf::Keyboard::Right)
+				setButton(held_.right, pressed_.right, down);
+			else if (event.key.code == sf::Keyboard::Up)
+				setButton(held_.shoot, pressed_.shoot, down);
+			else
+				handled = false;
+		}
+		else if ((event.type == sf::Event::MouseButtonPressed || event.type == sf::Event::MouseButtonReleased) &&
+			event.mouseButton.button == sf::Mouse::Left)
+		{
+			setButton(held_.mouseLeft, pressed_.mouseLeft, event.type == sf::Event::MouseButtonPressed);
+			held_.mouseX = event.mouseButton.x;
+			held_.mouseY = event.mouseButton.y;
+		}
+		else if (event.type == sf::Event::MouseMoved)
+		{
+			held_.mouseX = event.mouseMove.x;
+			held_.mouseY = event.mouseMove.y;
+		}
+		else if (event.type == sf::Event::LostFocus)
+		{
+			// puszczenie klawisza poza oknem nie przyjdzie jako zdarzenie
+			held_.left = held_.right = held_.shoot = held_.mouseLeft = false;
+		}
+		else
+		{
+			handled = false;
+		}
+
+		if (handled && firstEventTime_ < 0)
+			firstEventTime_ = time;
+	}
+
+	// trzymane przyciski; pressed dostaje naciśnięcia od poprzedniego odczytu, osobno, żeby SharedInput mógł je przechować do kroku symulacji
+	InputState read(InputState& pressed)
+	{
+		pressed = pressed_;
+		pressed_ = InputState();
+
+		if (firstEventTime_ >= 0)
+			latency_ = clock_.getElapsedTime().asMicroseconds() - firstEventTime_;
+		firstEventTime_ = -1;
+		return held_;
+	}
+
+	InputState read() override
+	{
+		InputState pressed;
+		InputState input = read(pressed);
+		input.left |= pressed.left;
+		input.right |= pressed.right;
+		input.shoot |= pressed.shoot;
+		input.mouseLeft |= pressed.mouseLeft;
+		return input;
+	}
+
+	// czas od pierwszego zdarzenia przed ostatnim read() do tego read(), w mikrosekundach
+	sf::Int64 getLatency()
+	{
+		return latency_;
+	}
+
+private:
+	static void setButton(bool& held, bool& pressed, bool down)
+	{
+		held = down;
+		pressed |= down;
+	}
+
+	sf::Clock clock_;
+	InputState held_;
+	InputState pressed_;
+	sf::Int64 firstEventTime_;
+	sf::Int64 latency_;
+};
+
+class RandomInput : public InputSource
+{
+public:
+	RandomInput(unsigned seed)
+		:random_(seed), input_(), ticksLeft_(0)
+	{ }
+
+	InputState read() override
+	{
+		// bot trzyma wylosowany kierunek przez losową liczbę klatek i strzela bez przerwy
+		if (ticksLeft_-- <= 0)
+		{
+			int move = random_() % 3;
+			input_.left = (move == 0);
+			input_.right = (move == 1);
+			ticksLeft_ = 30 + random_() % 90;
+		}
+		input_.shoot = true;
+		return input_;
+	}
+
+private:
+	std::mt19937 random_;
+	InputState input_;
+	int ticksLeft_;
+};
+
+// ostatni stan urządzeń odczytany przez wątek rysowania, z którego korzysta wątek symulacji;
+// cały stan mieści się w jednym słowie, więc wymiana nie potrzebuje blokady.
+// Naciśnięcia są dopisywane do słowa i zdejmowane dopiero przez read(), więc rysowanie szybsze niż symulacja ich nie nadpisze.
+class SharedInput : public InputSource
+{
+public:
+	SharedInput()
+		:packed_(0)
+	{ }
+
+	void publish(const InputState& held, const InputState& pressed)
+	{
+		std::uint64_t packed = packButtons(held);
+		packed |= (std::uint64_t)(std::uint16_t)held.mouseX << 16;
+		packed |= (std::uint64_t)(std::uint16_t)held.mouseY << 32;
+		std::uint64_t latched = packButtons(pressed) << 4;
+		std::uint64_t current = packed_;
+		while (!packed_.compare_exchange_weak(current, packed | (current & PRESSED_BITS) | latched))
+		{ }
+	}
+
+	InputState read() override
+	{
+		std::uint64_t packed = packed_.fetch_and(~PRESSED_BITS);
+		packed |= (packed & PRESSED_BITS) >> 4;
+		InputState input;
+		input.left = (packed & 1) != 0;
+		input.right = (packed & 2) != 0;
+		input.shoot = (packed & 4) != 0;
+		input.mouseLeft = (packed & 8) != 0;
+		input.mouseX = (std::int16_t)(packed >> 16);
+		input.mouseY = (std::int16_t)(packed >> 32);
+		return input;
+	}
+
+private:
+	static const std::uint64_t PRESSED_BITS = 0xf0;
+
+	static std::uint64_t packButtons(const InputState& input)
+	{
+		return (input.left ? 1 : 0) | (input.right ? 2 : 0) | (input.shoot ? 4 : 0) | (input.mouseLeft ? 8 : 0);
+	}
+
+	std::atomic<std::uint64_t> packed_;
+};
+
+// wejście odczytywane raz na krok w updateFrame()
+InputSource* inputSource = nullptr;
+InputState currentInput;
+unsigned randomSeed = 1;
+
+class Player: public Spaceship
+{
+public:
+	Player()
+		:Spaceship(3, 200, Vector2f(400, 620), 0.8f)
+	{ }
+
+	void update()
+	{
+		const InputState& input = currentInput;
+		prevPosition_ = position_;
+		if (input.right && position_.x < 950)
+			position_.x += speed_ * deltaTime;
+		if (input.left && position_.x > 0)
+			position_.x -= speed_ * deltaTime;
+
+		timeFromLastBullet_ += deltaTime;
+		if (timeFromLastBullet_ >= shootingSpeed_ && input.shoot)
+		{
+			timeFromLastBullet_ = 0;
+			shoot(Direction::UP);
+		}
+	}
+
+	const sf::Sprite& getHpSprite()
+	{
+		return hpSprite_;
+	}
+
+	void refillHp()
+	{
+		hp_ = 3;
+		hpVersion_++;
+	}
+
+	void setHpTexture(const std::string& hpTexture)
+	{
+		setSpriteTexture(hpSprite_, hpTexture);
+	}
+
+private:
+	sf::Sprite hpSprite_;
+};
+Player player;
+
+class EnemyBuilder
+{
+public:
+	EnemyBuilder(const std::string& name, int hp, int speed, float shootingSpeed, const std::string& texture)
+		:name_(name), hp_(hp), speed_(speed), shootingSpeed_(shootingSpeed), texture_(atlas.find(texture)) 
+	{ }
+
+	const std::string& getName()
+	{
+		return name_;
+	}
+
+	TextureHandle getTexture()
+	{
+		return texture_;
+	}
+	
+	EntityHandle create(int startX)
+	{
+		return enemys.add(hp_, speed_, Vector2f(startX, -10), shootingSpeed_, texture_);
+	}
+
+private:
+	std::string name_;
+	int hp_;
+	int speed_; 
+	float shootingSpeed_;
+	TextureHandle texture_;
+};
+std::vector<EnemyBuilder> builders_;
+
+void createEnemysBuilders()
+{
+	EnemyBuilder enemyNormal =   EnemyBuilder("normal",   30, 20, 3,   "enemy2");
+	EnemyBuilder enemyFastShot = EnemyBuilder("fastShot", 30, 25, 1.5, "enemy4");
+	EnemyBuilder enemyTank =     EnemyBuilder("tank",     60, 10, 4,   "enemy3");
+	EnemyBuilder enemySpecial =  EnemyBuilder("special",  45, 22, 2.5, "enemy1");
+	EnemyBuilder enemyBoss =     EnemyBuilder("boss",     100, 8 , 3,   "enemy1-250");
+
+	builders_ = { enemyNormal, enemyFastShot, enemyTank, enemySpecial, enemyBoss };
+}
+
+// jeden wpis poziomu; ten sam układ bajtów jest zapisywany w skompilowanym pliku .lvl
+class SpawnRecord
+{
+public:
+	float spawnTime;
+	std::int32_t startX;
+	std::int32_t builder;
+};
+static_assert(sizeof(SpawnRecord) == 12, "SpawnRecord is stored on disk");
+
+// nagłówek pliku .lvl; po nim następuje count rekordów posortowanych po spawnTime (little-endian)
+class LevelFileHeader
+{
+public:
+	char magic[4];
+	std::uint32_t version;
+	std::uint32_t count;
+	std::uint32_t reserved;
+};
+static_assert(sizeof(LevelFileHeader) == 16, "LevelFileHeader is stored on disk");
+
+const char levelFileMagic[4] = { 'S', 'I', 'L', 'V' };
+const std::uint32_t levelFileVersion = 1;
+
+// format tekstowy: jeden wróg na linię - "nazwa_buildera startX spawnTime", # zaczyna komentarz
+bool parseLevelText(const std::string& path, std::vector<SpawnRecord>& records)
+{
+	std::ifstream file(path);
+	if (!file)
+		return false;
+
+	records.clear();
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+		std::istringstream fields(line);
+		std::string builderName;
+		SpawnRecord record;
+		if (!(fields >> builderName))
+			continue;
+
+		record.builder = -1;
+		for (size_t i = 0; i < builders_.size(); i++)
+			if (builders_[i].getName() == builderName)
+				record.builder = (std::int32_t)i;
+		if (record.builder < 0 || !(fields >> record.startX >> record.spawnTime))
+		{
+			std::cerr << path << ":" << lineNumber << ": invalid entry" << std::endl;
+			continue;
+		}
+		records.push_back(record);
+	}
+
+	std::stable_sort(records.begin(), records.end(), [](const SpawnRecord& a, const SpawnRecord& b)
+	{
+		return a.spawnTime < b.spawnTime;
+	});
+	return true;
+}
+
+bool writeCompiledLevel(const std::string& path, const std::vector<SpawnRecord>& records)
+{
+	LevelFileHeader header;
+	std::memcpy(header.magic, levelFileMagic, sizeof(header.magic));
+	header.version = levelFileVersion;
+	header.count = (std::uint32_t)records.size();
+	header.reserved = 0;
+
+	std::ofstream file(path, std::ios::binary);
+	file.write((const char*)&header, sizeof(header));
+	if (!records.empty())
+		file.write((const char*)records.data(), records.size() * sizeof(SpawnRecord));
+	return (bool)file;
+}
+
+// --compile-levels: zamienia pliki .txt na .lvl obok nich
+int compileLevels(const std::vector<std::string>& paths)
+{
+	int failed = 0;
+	for (auto& path : paths)
+	{
+		std::vector<SpawnRecord> records;
+		std::string compiledPath = path.substr(0, path.rfind('.')) + ".lvl";
+		if (parseLevelText(path, records) && writeCompiledLevel(compiledPath, records))
+		{
+			std::cout << path << " -> " << compiledPath << " (" << records.size() << " spawns)" << std::endl;
+		}
+		else
+		{
+			std::cerr << "cannot compile " << path << std::endl;
+			failed++;
+		}
+	}
+	return failed == 0 ? 0 : 1;
+}
+
+class Button
+{
+public:
+	Button(Vector2f position)
+		:position_(position), sprite_(), bounds_(position.x, position.y, 0, 0), isClicked_(false)
+	{
+		sprite_.setPosition(sf::Vector2f(position.x, position.y));
+	}
+
+	// released - lewy przycisk myszy został puszczony w tym kroku; prostokąt jest sprawdzany tylko wtedy
+	void update(bool released)
+	{
+		isClicked_ = released &&
+			currentInput.mouseX >= bounds_.left && currentInput.mouseX <= bounds_.left + bounds_.width &&
+			currentInput.mouseY >= bounds_.top && currentInput.mouseY <= bounds_.top + bounds_.height;
+	}
+
+	bool isClicked()
+	{
+		return isClicked_;
+	}
+
+	sf::Sprite& getSprite()
+	{
+		return sprite_;
+	}
+
+	void setTexture(const std::string& texture)
+	{
+		setSpriteTexture(sprite_, texture);
+		bounds_.width = (float)sprite_.getTextureRect().width;
+		bounds_.height = (float)sprite_.getTextureRect().height;
+	}
+
+	Vector2f getPosition()
+	{
+		return position_;
+	}
+
+private:
+
+	Vector2f position_;
+	sf::Sprite sprite_;
+	sf::FloatRect bounds_;
+	bool isClicked_;
+};
+
+enum class EMainMenuState
+{
+	START_MENU,
+	LEVELS_MENU,
+	GAME_OVER,
+	LEVEL_PASSED,
+	NO_MENU
+};
+
+void startLevel(int level);
+
+// ustawiane przez przycisk wyjścia w wątku symulacji; okno zamyka wątek rysowania
+std::atomic<bool> quitRequested(false);
+
+class MainMenu
+{
+public:
+	MainMenu()
+		:startButton_(Vector2f(350, 250)), exitButton_(Vector2f(350, 350)), level1Button_(Vector2f(350, 200)),
+		level2Button_(Vector2f(350, 300)), level3Button_(Vector2f(350, 400)), exit2Button_(Vector2f(350, 500)), menuState_(EMainMenuState::NO_MENU),
+		prevMouseLeft_(false), version_(0)
+	{ }
+
+	void setButtonsTextures()
+	{
+		startButton_.setTexture("start_button");
+		exitButton_.setTexture("exit_button");
+		level1Button_.setTexture("level1_button");
+		level2Button_.setTexture("level2_button");
+		level3Button_.setTexture("level3_button");
+		exit2Button_.setTexture("exit_button");
+		setSpriteTexture(levelPassed_, "level_passed");
+		setSpriteTexture(gameOver_, "game_over");
+	}
+
+	// sprawdzane są tylko przyciski widocznego menu
+	void update()
+	{
+		bool released = prevMouseLeft_ && !currentInput.mouseLeft;
+		prevMouseLeft_ = currentInput.mouseLeft;
+
+		if (menuState_ == EMainMenuState::START_MENU)
+		{
+			startButton_.update(released);
+			exitButton_.update(released);
+			if (startButton_.isClicked())
+				setMenuState(EMainMenuState::LEVELS_MENU);
+			if (exitButton_.isClicked())
+				quitRequested = true;
+		}
+		else if (menuState_ == EMainMenuState::LEVELS_MENU)
+		{
+			level1Button_.update(released);
+			level2Button_.update(released);
+			level3Button_.update(released);
+			exit2Button_.update(released);
+			if (level1Button_.isClicked())
+			{
+				startLevel(1);
+				setMenuState(EMainMenuState::NO_MENU);
+			}
+			else if (level2Button_.isClicked())
+			{
+				startLevel(2);
+				setMenuState(EMainMenuState::NO_MENU);
+			}
+			else if (level3Button_.isClicked())
+			{
+				startLevel(3);
+				setMenuState(EMainMenuState::NO_MENU);
+			}
+			else if (exit2Button_.isClicked())
+			{
+				setMenuState(EMainMenuState::START_MENU);
+			}
+		}
+		else if (menuState_ == EMainMenuState::GAME_OVER || menuState_ == EMainMenuState::LEVEL_PASSED)
+		{
+			endSceeenTimer_ -= deltaTime;
+			if (endSceeenTimer_ <= 0)
+			{
+				setMenuState(EMainMenuState::LEVELS_MENU);
+			}
+		}
+	}
+
+	// stan menu przychodzi z migawki, bo menuState_ zmienia wątek symulacji
+	void draw(EMainMenuState menuState)
+	{
+		if (menuState == EMainMenuState::START_MENU)
+		{
+			drawObject(startButton_.getSprite(), startButton_.getPosition());
+			drawObject(exitButton_.getSprite(), exitButton_.getPosition());
+		}
+		else if (menuState == EMainMenuState::LEVELS_MENU)
+		{
+			drawObject(level1Button_.getSprite(), level1Button_.getPosition());
+			drawObject(level2Button_.getSprite(), level2Button_.getPosition());
+			drawObject(level3Button_.getSprite(), level3Button_.getPosition());
+			drawObject(exit2Button_.getSprite(), exit2Button_.getPosition());
+		}
+		else if (menuState == EMainMenuState::GAME_OVER)
+		{
+			drawObject(gameOver_, Vector2f(0, 0));
+		}
+		else if (menuState == EMainMenuState::LEVEL_PASSED)
+		{
+			drawObject(levelPassed_, Vector2f(0, 0));
+		}
+	}
+
+	EMainMenuState getMenuState()
+	{
+		return menuState_;
+	}
+
+	void setMenuState(EMainMenuState type)
+	{
+		menuState_ = type;
+		endSceeenTimer_ = 5;
+		version_++;
+	}
+
+	// zmienia się przy każdej zmianie menu; warstwa menu jest wtedy rysowana od nowa
+	std::uint32_t getVersion()
+	{
+		return version_;
+	}
+
+	class State
+	{
+	public:
+		EMainMenuState menuState;
+		float endScreenTimer;
+		bool prevMouseLeft;
+	};
+
+	void save(State& state)
+	{
+		state.menuState = menuState_;
+		state.endScreenTimer = endSceeenTimer_;
+		state.prevMouseLeft = prevMouseLeft_;
+	}
+
+	void restore(const State& state)
+	{
+		menuState_ = state.menuState;
+		endSceeenTimer_ = state.endScreenTimer;
+		prevMouseLeft_ = state.prevMouseLeft;
+		version_++;
+	}
+
+private:
+	EMainMenuState menuState_;
+
+	Button startButton_;
+	Button exitButton_;
+
+	Button level1Button_;
+	Button level2Button_;
+	Button level3Button_;
+	Button exit2Button_;
+
+	sf::Sprite gameOver_;
+	sf::Sprite levelPassed_;
+
+	float endSceeenTimer_;
+	bool prevMouseLeft_;
+	std::uint32_t version_;
+};
+
+MainMenu mainMenu;
+
+// tryb bez końca: wrogowie są losowani na bieżąco z ziarna, najwyżej ENDLESS_LOOKAHEAD sekund przed currentTime_,
+// do pierścienia o stałym rozmiarze, więc długa sesja nie zajmuje coraz więcej pamięci
+#define ENDLESS_LEVEL 0
+#define ENDLESS_WINDOW_SIZE 64
+#define ENDLESS_LOOKAHEAD 2.f
+#define ENDLESS_START_INTERVAL 2.f
+#define ENDLESS_MIN_INTERVAL 0.25f
+// co tyle sekund odstęp między wrogami maleje i dochodzi kolejny rodzaj wroga
+#define ENDLESS_RAMP_TIME 60.f
+// czas poziomu jest float, więc co ENDLESS_EPOCH sekund jest cofany o tyle samo, żeby nie tracił dokładności w długiej sesji
+#define ENDLESS_EPOCH 1024.f
+// tyle wrogów jest przydzielanych z góry; przy najkrótszym odstępie mieści się prawie cały przelot najwolniejszego
+#define ENDLESS_RESERVED_ENEMYS 512
+
+class EndlessGenerator
+{
+public:
+	EndlessGenerator()
+		:first_(0), count_(0), nextTime_(0), epochs_(0)
+	{ }
+
+	void start(unsigned seed)
+	{
+		random_.seed(seed);
+		first_ = 0;
+		count_ = 0;
+		nextTime_ = ENDLESS_START_INTERVAL;
+		epochs_ = 0;
+	}
+
+	// przesuwa czasy oczekujących wrogów o ENDLESS_EPOCH wstecz razem z czasem poziomu
+	void rebase()
+	{
+		for (int i = 0; i < count_; i++)
+			window_[(first_ + i) % ENDLESS_WINDOW_SIZE].spawnTime -= ENDLESS_EPOCH;
+		nextTime_ -= ENDLESS_EPOCH;
+		epochs_++;
+	}
+
+	// dopisuje wrogów pojawiających się do untilTime, dopóki jest miejsce w pierścieniu
+	void generate(float untilTime)
+	{
+		while (count_ < ENDLESS_WINDOW_SIZE && nextTime_ <= untilTime)
+		{
+			double time = epochs_ * (double)ENDLESS_EPOCH + nextTime_;
+			int buildersCount = (int)std::min((double)builders_.size(), 2 + time / ENDLESS_RAMP_TIME);
+			SpawnRecord& record = window_[(first_ + count_) % ENDLESS_WINDOW_SIZE];
+			record.spawnTime = nextTime_;
+			record.startX = 60 + (int)(random_() % 880);
+			record.builder = (int)(random_() % buildersCount);
+			count_++;
+
+			float interval = std::max(ENDLESS_MIN_INTERVAL, (float)(ENDLESS_START_INTERVAL / (1 + time / ENDLESS_RAMP_TIME)));
+			nextTime_ += interval * (0.5f + (random_() % 1000) / 1000.f);
+		}
+	}
+
+	bool isEmpty()
+	{
+		return count_ == 0;
+	}
+
+	const SpawnRecord& front()
+	{
+		return window_[first_];
+	}
+
+	void pop()
+	{
+		first_ = (first_ + 1) % ENDLESS_WINDOW_SIZE;
+		count_--;
+	}
+
+private:
+	std::mt19937 random_;
+	SpawnRecord window_[ENDLESS_WINDOW_SIZE];
+	int first_;
+	int count_;
+	float nextTime_;
+	int epochs_;
+};
+
+class LevelManager
+{
+public:
+	LevelManager()
+		:records_(nullptr), recordsCount_(0), nextRecord_(0), currentTime_(0), endless_(false)
+	{ }
+
+	void startEndless(unsigned seed)
+	{
+		clear();
+		endless_ = true;
+		endlessGenerator_.start(seed);
+	}
+
+	// skompilowany plik jest mapowany i czytany bezpośrednio; tekstowy jest parsowany, gdy nie ma .lvl albo jest od niego nowszy
+	bool load(const std::string& compiledPath, const std::string& textPath)
+	{
+		clear();
+		if (getModificationTime(compiledPath) >= getModificationTime(textPath) && mappedLevel_.open(compiledPath))
+		{
+			const LevelFileHeader* header = (const LevelFileHeader*)mappedLevel_.data();
+			bool valid = mappedLevel_.size() >= sizeof(LevelFileHeader) &&
+				std::memcmp(header->magic, levelFileMagic, sizeof(header->magic)) == 0 && header->version == levelFileVersion &&
+				mappedLevel_.size() == sizeof(LevelFileHeader) + (std::uint64_t)header->count * sizeof(SpawnRecord);
+			const SpawnRecord* records = (const SpawnRecord*)(mappedLevel_.data() + sizeof(LevelFileHeader));
+			// wpisy są potem używane bez sprawdzania: indeks buildera wprost, a kursor spawnu zakłada rosnące czasy
+			for (std::uint32_t i = 0; valid && i < header->count; i++)
+				valid = records[i].builder >= 0 && records[i].builder < (std::int32_t)builders_.size() &&
+					(i == 0 || records[i - 1].spawnTime <= records[i].spawnTime);
+			if (valid)
+			{
+				records_ = records;
+				recordsCount_ = (int)header->count;
+				return true;
+			}
+			std::cerr << "invalid level file " << compiledPath << ", loading " << textPath << std::endl;
+			mappedLevel_.close();
+		}
+
+		if (!parseLevelText(textPath, ownedRecords_))
+		{
+			std::cerr << "cannot load level " << textPath << std::endl;
+			return false;
+		}
+		records_ = ownedRecords_.data();
+		recordsCount_ = (int)ownedRecords_.size();
+		return true;
+	}
+
+	void clear()
+	{
+		mappedLevel_.close();
+		ownedRecords_.clear();
+		records_ = nullptr;
+		recordsCount_ = 0;
+		nextRecord_ = 0;
+		endless_ = false;
+
+		enemys.clear();
+		bullets.clear();
+
+		currentTime_ = 0;
+	}
+
+	void updateLevel()
+	{
+		if (player.getHp() <= 0)
+		{
+			mainMenu.setMenuState(EMainMenuState::GAME_OVER);
+			player.refillHp();
+		}
+		else if (!endless_ && enemys.size() == 0 && nextRecord_ == recordsCount_)
+		{
+			mainMenu.setMenuState(EMainMenuState::LEVEL_PASSED);
+			player.refillHp();
+		}
+
+		currentTime_ += deltaTime;
+		if (endless_)
+		{
+			if (currentTime_ >= ENDLESS_EPOCH)
+			{
+				currentTime_ -= ENDLESS_EPOCH;
+				endlessGenerator_.rebase();
+			}
+			endlessGenerator_.generate(currentTime_ + ENDLESS_LOOKAHEAD);
+			while (!endlessGenerator_.isEmpty() && endlessGenerator_.front().spawnTime <= currentTime_)
+			{
+				spawn(endlessGenerator_.front());
+				endlessGenerator_.pop();
+				nextRecord_++;
+			}
+		}
+		while (nextRecord_ < recordsCount_ && records_[nextRecord_].spawnTime <= currentTime_)
+		{
+			spawn(records_[nextRecord_]);
+			nextRecord_++;
+		}
+	}
+
+	float getCurrentTime()
+	{
+		return currentTime_;
+	}
+
+	int getRecordsCount()
+	{
+		return recordsCount_;
+	}
+
+	int getNextRecord()
+	{
+		return nextRecord_;
+	}
+
+	// pozycja w poziomie; wpisy poziomu zostają w pamięci, więc przywracać można tylko w obrębie wczytanego poziomu
+	class State
+	{
+	public:
+		float currentTime;
+		int nextRecord;
+		bool endless;
+		EndlessGenerator endlessGenerator;
+	};
+
+	void save(State& state)
+	{
+		state.currentTime = currentTime_;
+		state.nextRecord = nextRecord_;
+		state.endless = endless_;
+		state.endlessGenerator = endlessGenerator_;
+	}
+
+	void restore(const State& state)
+	{
+		currentTime_ = state.currentTime;
+		nextRecord_ = state.nextRecord;
+		endless_ = state.endless;
+		endlessGenerator_ = state.endlessGenerator;
+	}
+
+private:
+	void spawn(const SpawnRecord& record)
+	{
+		int enemy = enemys.find(builders_[record.builder].create(record.startX));
+		enemys.setPosition(enemy, enemys.getPosition(enemy) - enemys.getSize(enemy)*0.5);
+	}
+
+	MappedFile mappedLevel_;
+	std::vector<SpawnRecord> ownedRecords_;
+	const SpawnRecord* records_;
+	int recordsCount_;
+	int nextRecord_;
+	float currentTime_;
+	bool endless_;
+	EndlessGenerator endlessGenerator_;
+};
+
+LevelManager levelManager;
+
+bool areObjectsCollide(Spaceship& spaceship, Vector2f bulletPos, sf::Vector2u bulletSize)
+{
+	auto spaceshipSize = spaceship.getSize();
+	auto spaceshipPos = spaceship.getPostion();
+
+	return (spaceshipPos.x <= bulletPos.x + bulletSize.x && spaceshipPos.x + spaceshipSize.x >= bulletPos.x) &&
+		(spaceshipPos.y <= bulletPos.y + bulletSize.y && spaceshipPos.y + spaceshipSize.y >= bulletPos.y);
+}
+
+class CollisionBox
+{
+public:
+	float left, top, right, bottom;
+};
+
+// maska bitowa prostokątów z bloku COLLISION_BLOCK kolejnych elementów tablic, które nachodzą na box;
+// porównania są te same co w areObjectsCollide(), więc wynik jest identyczny
+inline unsigned collideBlock(const float* left, const float* top, const float* right, const float* bottom, const CollisionBox& box)
+{
+#if defined(COLLISION_SIMD_AVX)
+	__m256 horizontal = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(left), _mm256_set1_ps(box.right), _CMP_LE_OQ),
+		_mm256_cmp_ps(_mm256_loadu_ps(right), _mm256_set1_ps(box.left), _CMP_GE_OQ));
+	__m256 vertical = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(top), _mm256_set1_ps(box.bottom), _CMP_LE_OQ),
+		_mm256_cmp_ps(_mm256_loadu_ps(bottom), _mm256_set1_ps(box.top), _CMP_GE_OQ));
+	return (unsigned)_mm256_movemask_ps(_mm256_and_ps(horizontal, vertical));
+#elif defined(COLLISION_SIMD_SSE2)
+	unsigned mask = 0;
+	for (int half = 0; half < COLLISION_BLOCK; half += 4)
+	{
+		__m128 horizontal = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(left + half), _mm_set1_ps(box.right)),
+			_mm_cmpge_ps(_mm_loadu_ps(right + half), _mm_set1_ps(box.left)));
+		__m128 vertical = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(top + half), _mm_set1_ps(box.bottom)),
+			_mm_cmpge_ps(_mm_loadu_ps(bottom + half), _mm_set1_ps(box.top)));
+		mask |= (unsigned)_mm_movemask_ps(_mm_and_ps(horizontal, vertical)) << half;
+	}
+	return mask;
+#else
+	unsigned mask = 0;
+	for (int i = 0; i < COLLISION_BLOCK; i++)
+		if (left[i] <= box.right && right[i] >= box.left && top[i] <= box.bottom && bottom[i] >= box.top)
+			mask |= 1u << i;
+	return mask;
+#endif
+}
+
+// to samo dla prostokątów o wspólnym rozmiarze (pociski jednego kierunku) - prawa i dolna krawędź są liczone w locie
+inline unsigned collideSizedBlock(const float* left, const float* top, float width, float height, const CollisionBox& box)
+{
+#if defined(COLLISION_SIMD_AVX)
+	__m256 x = _mm256_loadu_ps(left);
+	__m256 y = _mm256_loadu_ps(top);
+	__m256 horizontal = _mm256_and_ps(_mm256_cmp_ps(x, _mm256_set1_ps(box.right), _CMP_LE_OQ),
+		_mm256_cmp_ps(_mm256_add_ps(x, _mm256_set1_ps(width)), _mm256_set1_ps(box.left), _CMP_GE_OQ));
+	__m256 vertical = _mm256_and_ps(_mm256_cmp_ps(y, _mm256_set1_ps(box.bottom), _CMP_LE_OQ),
+		_mm256_cmp_ps(_mm256_add_ps(y, _mm256_set1_ps(height)), _mm256_set1_ps(box.top), _CMP_GE_OQ));
+	return (unsigned)_mm256_movemask_ps(_mm256_and_ps(horizontal, vertical));
+#elif defined(COLLISION_SIMD_SSE2)
+	unsigned mask = 0;
+	for (int half = 0; half < COLLISION_BLOCK; half += 4)
+	{
+		__m128 x = _mm_loadu_ps(left + half);
+		__m128 y = _mm_loadu_ps(top + half);
+		__m128 horizontal = _mm_and_ps(_mm_cmple_ps(x, _mm_set1_ps(box.right)),
+			_mm_cmpge_ps(_mm_add_ps(x, _mm_set1_ps(width)), _mm_set1_ps(box.left)));
+		__m128 vertical = _mm_and_ps(_mm_cmple_ps(y, _mm_set1_ps(box.bottom)),
+			_mm_cmpge_ps(_mm_add_ps(y, _mm_set1_ps(height)), _mm_set1_ps(box.top)));
+		mask |= (unsigned)_mm_movemask_ps(_mm_and_ps(horizontal, vertical)) << half;
+	}
+	return mask;
+#else
+	unsigned mask = 0;
+	for (int i = 0; i < COLLISION_BLOCK; i++)
+		if (left[i] <= box.right && left[i] + width >= box.left && top[i] <= box.bottom && top[i] + height >= box.top)
+			mask |= 1u << i;
+	return mask;
+#endif
+}
+
+// maska pierwszych count elementów bloku
+inline unsigned getBlockMask(int count)
+{
+	return (count >= COLLISION_BLOCK) ? (1u << COLLISION_BLOCK) - 1 : (1u << count) - 1;
+}
+
+CollisionBox getCollisionBox(Vector2f position, float width, float height)
+{
+	CollisionBox box = { position.x, position.y, position.x + width, position.y + height };
+	return box;
+}
+
+// dokładny test po teście prostokątów: maska b jest przesuwana o zaokrągloną różnicę pozycji i porównywana z maską a
+// po 64 kolumny naraz; obiekt bez maski zachowuje się jak pełny prostokąt
+bool masksOverlap(const AlphaMask& a, Vector2f positionA, const AlphaMask& b, Vector2f positionB)
+{
+	if (a.isEmpty() || b.isEmpty())
+		return true;
+
+	int dx = (int)std::floor(positionB.x - positionA.x + 0.5f);
+	int dy = (int)std::floor(positionB.y - positionA.y + 0.5f);
+	int top = std::max(0, dy), bottom = std::min(a.height, dy + b.height);
+	int left = std::max(0, dx), right = std::min(a.width, dx + b.width);
+	for (int row = top; row < bottom; row++)
+		for (int column = left; column < right; column += 64)
+			if (a.getBits(row, column) & b.getBits(row - dy, column - dx))
+				return true;
+	return false;
+}
+
+// siatka na planszy 1000x700 - pocisk jest sprawdzany tylko z wrogami z komórek, które zajmuje
+class CollisionGrid
+{
+#define GRID_CELL_SIZE 50
+#define GRID_COLUMNS (1000 / GRID_CELL_SIZE)
+#define GRID_ROWS (700 / GRID_CELL_SIZE)
+
+public:
+	CollisionGrid()
+		:cellStart_(GRID_COLUMNS * GRID_ROWS + 1)
+	{ }
+
+	// przydziela tablice dla enemysCount wrogów naraz; wróg o szerokości w zajmuje najwyżej w / GRID_CELL_SIZE + 2 kolumn (tak samo wiersze)
+	void reserve(int enemysCount)
+	{
+		int maxCells = 1;
+		for (auto& builder : builders_)
+		{
+			if (!builder.getTexture().isValid())
+				continue;
+			const sf::IntRect& rect = atlas.getRegion(builder.getTexture()).rect;
+			int columns = std::min(rect.width / GRID_CELL_SIZE + 2, GRID_COLUMNS);
+			int rows = std::min(rect.height / GRID_CELL_SIZE + 2, GRID_ROWS);
+			maxCells = std::max(maxCells, columns * rows);
+		}
+
+		int entriesCount = enemysCount * maxCells;
+		ranges_.reserve(enemysCount);
+		entries_.reserve(entriesCount);
+		cellFill_.reserve(cellStart_.size());
+		for (auto* coordinates : { &left_, &top_, &right_, &bottom_ })
+			coordinates->reserve(entriesCount + COLLISION_BLOCK);
+	}
+
+	void build(EnemyStore& enemys)
+	{
+		// sortowanie przez zliczanie: najpierw liczba wpisów w każdej komórce, potem ich rozłożenie w jednej tablicy
+		std::fill(cellStart_.begin(), cellStart_.end(), 0);
+		ranges_.resize(enemys.size());
+		for (int i = 0; i < enemys.size(); i++)
+		{
+			CellRange range = ranges_[i] = getCellRange(enemys, i);
+			for (int row = range.top; row <= range.bottom; row++)
+				for (int column = range.left; column <= range.right; column++)
+					cellStart_[row * GRID_COLUMNS + column + 1]++;
+		}
+		for (size_t cell = 1; cell < cellStart_.size(); cell++)
+			cellStart_[cell] += cellStart_[cell - 1];
+
+		entries_.resize(cellStart_.back());
+		cellFill_.assign(cellStart_.begin(), cellStart_.end() - 1);
+		// prostokąty wrogów są kopiowane w kolejności wpisów, więc każda komórka to ciągły fragment tablic dla collideBlock()
+		left_.resize(entries_.size() + COLLISION_BLOCK);
+		top_.resize(entries_.size() + COLLISION_BLOCK);
+		right_.resize(entries_.size() + COLLISION_BLOCK);
+		bottom_.resize(entries_.size() + COLLISION_BLOCK);
+		for (int i = 0; i < enemys.size(); i++)
+		{
+			CellRange range = ranges_[i];
+			auto size = enemys.getSize(i);
+			CollisionBox box = getCollisionBox(enemys.getPosition(i), size.x, size.y);
+			for (int row = range.top; row <= range.bottom; row++)
+			{
+				for (int column = range.left; column <= range.right; column++)
+				{
+					int entry = cellFill_[row * GRID_COLUMNS + column]++;
+					entries_[entry] = i;
+					left_[entry] = box.left;
+					top_[entry] = box.top;
+					right_[entry] = box.right;
+					bottom_[entry] = box.bottom;
+				}
+			}
+		}
+	}
+
+	// wywołuje callback(indeks) raz dla każdego wroga, którego prostokąt nachodzi na box; wrogowie z komórek
+	// przecinanych przez box są sprawdzani blokami po COLLISION_BLOCK. Nie zmienia siatki, więc może być wołane z wielu wątków naraz
+	template <typename Callback>
+	void collide(const CollisionBox& box, Callback callback) const
+	{
+		CellRange range = getCellRange(box.left, box.top, box.right, box.bottom);
+		for (int row = range.top; row <= range.bottom; row++)
+		{
+			for (int column = range.left; column <= range.right; column++)
+			{
+				int cell = row * GRID_COLUMNS + column;
+				for (int block = cellStart_[cell]; block < cellStart_[cell + 1]; block += COLLISION_BLOCK)
+				{
+					unsigned mask = collideBlock(&left_[block], &top_[block], &right_[block], &bottom_[block], box) &
+						getBlockMask(cellStart_[cell + 1] - block);
+					for (int bit = 0; mask != 0; bit++, mask >>= 1)
+					{
+						if ((mask & 1) == 0)
+							continue;
+
+						// wróg zajmujący kilka komórek jest zgłaszany tylko w pierwszej komórce wspólnej z zapytaniem
+						int index = entries_[block + bit];
+						const CellRange& owner = ranges_[index];
+						if (row != std::max(range.top, owner.top) || column != std::max(range.left, owner.left))
+							continue;
+						callback(index);
+					}
+				}
+			}
+		}
+	}
+
+private:
+	class CellRange
+	{
+	public:
+		int left, top, right, bottom;
+	};
+
+	static int toCell(float coordinate, int cells)
+	{
+		// obiekty poza planszą trafiają do skrajnych komórek, więc nakładające się prostokąty zawsze mają wspólną komórkę
+		int cell = (int)std::floor(coordinate / GRID_CELL_SIZE);
+		return std::max(0, std::min(cells - 1, cell));
+	}
+
+	static CellRange getCellRange(float left, float top, float right, float bottom)
+	{
+		CellRange range;
+		range.left = toCell(left, GRID_COLUMNS);
+		range.top = toCell(top, GRID_ROWS);
+		range.right = toCell(right, GRID_COLUMNS);
+		range.bottom = toCell(bottom, GRID_ROWS);
+		return range;
+	}
+
+	static CellRange getCellRange(EnemyStore& enemys, int index)
+	{
+		auto position = enemys.getPosition(index);
+		auto size = enemys.getSize(index);
+		return getCellRange(position.x, position.y, position.x + size.x, position.y + size.y);
+	}
+
+	std::vector<int> cellStart_;
+	std::vector<int> cellFill_;
+	std::vector<int> entries_;
+	std::vector<CellRange> ranges_;
+	std::vector<float> left_;
+	std::vector<float> top_;
+	std::vector<float> right_;
+	std::vector<float> bottom_;
+};
+
+CollisionGrid collisionGrid;
+
+class BulletHit
+{
+public:
+	int bullet;
+	int enemy;
+};
+ChunkResults<int> playerHits;
+ChunkResults<BulletHit> enemyHits;
+
+// trafienia są szukane równolegle w kawałkach, a obrażenia i usuwanie pocisków stosowane potem w kolejności pocisków
+void updateCollisions()
+{
+	// collisions with player
+	BulletLane& enemyBullets = bullets.enemyBullets;
+	auto playerSize = player.getSize();
+	CollisionBox playerBox = getCollisionBox(player.getPostion(), playerSize.x, playerSize.y);
+	float enemyBulletWidth = (float)enemyBullets.getSize().x, enemyBulletHeight = (float)enemyBullets.getSize().y;
+	const AlphaMask& playerMask = atlas.getMask(player.getTexture());
+	const AlphaMask& enemyBulletMask = atlas.getMask(enemyBullets.getTexture());
+	playerHits.reset(JobSystem::getChunksCount(enemyBullets.size(), BULLETS_CHUNK_SIZE), BULLETS_CHUNK_SIZE);
+	jobs.parallelFor(enemyBullets.size(), BULLETS_CHUNK_SIZE, [&](int chunk, int begin, int end)
+	{
+		for (int block = begin; block < end; block += COLLISION_BLOCK)
+		{
+			unsigned mask = collideSizedBlock(enemyBullets.getX() + block, enemyBullets.getY() + block, enemyBulletWidth, enemyBulletHeight,
+				playerBox) & getBlockMask(end - block);
+			for (int bit = 0; mask != 0; bit++, mask >>= 1)
+				if ((mask & 1) && masksOverlap(playerMask, player.getPostion(), enemyBulletMask, enemyBullets.getPosition(block + bit)))
+					playerHits[chunk].push_back(block + bit);
+		}
+	});
+	playerHits.forEach([&](int bullet)
+	{
+		player.takeDamage(1);
+		enemyBullets.kill(bullet);
+	});
+
+	// collisions with enemys
+	collisionGrid.build(enemys);
+	BulletLane& playerBullets = bullets.playerBullets;
+	auto bulletSize = playerBullets.getSize();
+	const AlphaMask& playerBulletMask = atlas.getMask(playerBullets.getTexture());
+	enemyHits.reset(JobSystem::getChunksCount(playerBullets.size(), ENEMYS_CHUNK_SIZE), ENEMYS_CHUNK_SIZE);
+	jobs.parallelFor(playerBullets.size(), ENEMYS_CHUNK_SIZE, [&](int chunk, int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			Vector2f bulletPos = playerBullets.getPosition(i);
+			CollisionBox bulletBox = getCollisionBox(bulletPos, (float)bulletSize.x, (float)bulletSize.y);
+			collisionGrid.collide(bulletBox, [&](int index)
+			{
+				if (masksOverlap(atlas.getMask(enemys.getTexture(index)), enemys.getPosition(index), playerBulletMask, bulletPos))
+					enemyHits[chunk].push_back(BulletHit{ i, index });
+			});
+		}
+	});
+	enemyHits.forEach([&](const BulletHit& hit)
+	{
+		enemys.takeDamage(hit.enemy, 10);
+		playerBullets.kill(hit.bullet);
+	});
+}
+
+#include<iostream>
+void registerTextures()
+{
+	atlas.addImage("player", "img/player.png");
+	atlas.addImage("bullet_green", "img/green-bullet.png");
+	atlas.addImage("bullet_red", "img/red-bullet.png");
+	atlas.addImage("enemy1", "img/enemy1.png");
+	atlas.addImage("enemy1-250", "img/enemy1-250.png");
+	atlas.addImage("enemy2", "img/enemy2.png");
+	atlas.addImage("enemy3", "img/enemy3.png");
+	atlas.addImage("enemy4", "img/enemy4.png");
+	atlas.addImage("start_button", "img/start.png");
+	atlas.addImage("exit_button", "img/exit.png");
+	atlas.addImage("level1_button", "img/level1.png");
+	atlas.addImage("level2_button", "img/level2.png");
+	atlas.addImage("level3_button", "img/level3.png");
+	atlas.addImage("level_passed", "img/level_passed.png");
+	atlas.addImage("game_over", "img/game_over.png");
+	atlas.addImage("heart", "img/heart.png");
+	atlas.addImage("bg", "img/bg_fin.png");
+}
+
+const char* musicPaths[] = { "music/muzyka.ogg", "music/muzyka.flac", "music/muzyka.wav" };
+
+// paczka zasobów (.pak): strony atlasu jako surowe RGBA, prostokąty i maski obrazków oraz niezmienione pliki muzyki.
+// Plik jest mapowany w pamięci, a tekstury i muzyka korzystają bezpośrednio z jego bajtów (little-endian).
+class PackHeader
+{
+public:
+	char magic[4];
+	std::uint32_t version;
+	std::uint32_t pagesCount;
+	std::uint32_t imagesCount;
+	std::uint32_t filesCount;
+	std::uint32_t reserved;
+};
+static_assert(sizeof(PackHeader) == 24, "PackHeader is stored on disk");
+
+class PackPage
+{
+public:
+	std::uint32_t width;
+	std::uint32_t height;
+	std::uint64_t offset;
+};
+static_assert(sizeof(PackPage) == 16, "PackPage is stored on disk");
+
+class PackImage
+{
+public:
+	char name[32];
+	char path[64];
+	std::int32_t page;
+	std::int32_t left;
+	std::int32_t top;
+	std::int32_t width;
+	std::int32_t height;
+	// 0, gdy obrazka nie udało się wczytać przy pakowaniu
+	std::uint32_t maskWords;
+	std::uint64_t maskOffset;
+};
+static_assert(sizeof(PackImage) == 128, "PackImage is stored on disk");
+
+class PackFile
+{
+public:
+	char path[64];
+	std::uint64_t offset;
+	std::uint64_t size;
+};
+static_assert(sizeof(PackFile) == 80, "PackFile is stored on disk");
+
+const char packFileMagic[4] = { 'S', 'I', 'P', 'K' };
+const std::uint32_t packFileVersion = 1;
+
+// po otwarciu paczka pozostaje zmapowana do końca programu - strumień muzyki czyta z niej na bieżąco
+MappedFile assetPack;
+
+const PackHeader* getPackHeader()
+{
+	return (const PackHeader*)assetPack.data();
+}
+
+const PackPage* getPackPages()
+{
+	return (const PackPage*)(assetPack.data() + sizeof(PackHeader));
+}
+
+const PackImage* getPackImages()
+{
+	return (const PackImage*)(getPackPages() + getPackHeader()->pagesCount);
+}
+
+const PackFile* getPackFiles()
+{
+	return (const PackFile*)(getPackImages() + getPackHeader()->imagesCount);
+}
+
+// mapuje paczkę, jeśli jest poprawna i nie starsza od żadnego z plików, z których powstała
+bool openAssetPack(const std::string& path)
+{
+	if (!assetPack.open(path))
+		return false;
+
+	const PackHeader* header = getPackHeader();
+	size_t size = assetPack.size();
+	auto fits = [size](std::uint64_t offset, std::uint64_t length)
+	{
+		return offset <= size && length <= size - offset;
+	};
+	bool valid = size >= sizeof(PackHeader) && std::memcmp(header->magic, packFileMagic, sizeof(header->magic)) == 0 &&
+		header->version == packFileVersion &&
+		fits(sizeof(PackHeader), (std::uint64_t)header->pagesCount * sizeof(PackPage) + (std::uint64_t)header->imagesCount * sizeof(PackImage) +
+			(std::uint64_t)header->filesCount * sizeof(PackFile));
+	for (std::uint32_t i = 0; valid && i < header->pagesCount; i++)
+		valid = fits(getPackPages()[i].offset, (std::uint64_t)getPackPages()[i].width * getPackPages()[i].height * 4);
+	for (std::uint32_t i = 0; valid && i < header->imagesCount; i++)
+	{
+		const PackImage& image = getPackImages()[i];
+		valid = image.page >= 0 && (std::uint32_t)image.page < header->pagesCount && image.maskOffset % 8 == 0 &&
+			fits(image.maskOffset, (std::uint64_t)image.maskWords * 8) &&
+			(image.maskWords == 0 || image.maskWords == (std::uint64_t)((image.width + 63) / 64 + 1) * image.height);
+	}
+	for (std::uint32_t i = 0; valid && i < header->filesCount; i++)
+		valid = fits(getPackFiles()[i].offset, getPackFiles()[i].size);
+	if (!valid)
+	{
+		std::cerr << "invalid asset pack " << path << std::endl;
+		assetPack.close();
+		return false;
+	}
+
+	// tak jak przy poziomach: zmieniony plik źródłowy ma pierwszeństwo przed paczką
+	long long packTime = getModificationTime(path);
+	for (std::uint32_t i = 0; i < header->imagesCount + header->filesCount; i++)
+	{
+		const char* source = i < header->imagesCount ? getPackImages()[i].path : getPackFiles()[i - header->imagesCount].path;
+		if (getModificationTime(source) > packTime)
+		{
+			std::cerr << "asset pack " << path << " is older than " << source << ", loading files" << std::endl;
+			assetPack.close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void loadTexturesFromPack()
+{
+	const PackHeader* header = getPackHeader();
+	for (std::uint32_t i = 0; i < header->pagesCount; i++)
+	{
+		const PackPage& page = getPackPages()[i];
+		atlas.addPage(page.width, page.height, assetPack.data() + page.offset, !headless);
+	}
+	for (std::uint32_t i = 0; i < header->imagesCount; i++)
+	{
+		const PackImage& image = getPackImages()[i];
+		AtlasRegion region;
+		region.page = image.page;
+		region.rect = sf::IntRect(image.left, image.top, image.width, image.height);
+		AlphaMask mask;
+		if (image.maskWords > 0)
+			mask.create(image.width, image.height, (const std::uint64_t*)(assetPack.data() + image.maskOffset));
+		atlas.addRegion(std::string(image.name, strnlen(image.name, sizeof(image.name))),
+			std::string(image.path, strnlen(image.path, sizeof(image.path))), region, mask);
+	}
+}
+
+// plik zapisany w paczce albo nullptr
+const PackFile* findPackedFile(const std::string& path)
+{
+	if (assetPack.size() == 0)
+		return nullptr;
+	for (std::uint32_t i = 0; i < getPackHeader()->filesCount; i++)
+		if (path == std::string(getPackFiles()[i].path, strnlen(getPackFiles()[i].path, sizeof(getPackFiles()[i].path))))
+			return &getPackFiles()[i];
+	return nullptr;
+}
+
+// z otwartej paczki albo z plików w img/
+void loadTextures(bool parallel)
+{
+	if (assetPack.size() > 0)
+	{
+		loadTexturesFromPack();
+		return;
+	}
+	registerTextures();
+	atlas.build(!headless, parallel);
+}
+
+// --pack-assets: dekoduje obrazki, składa strony atlasu tak jak przy zwykłym starcie i zapisuje je razem z muzyką do paczki
+int packAssets(const std::string& path)
+{
+	registerTextures();
+	std::vector<sf::Image> pageImages;
+	atlas.build(false, true, &pageImages);
+
+	std::vector<std::string> files;
+	for (const char* musicPath : musicPaths)
+		if (getModificationTime(musicPath) != 0)
+			files.push_back(musicPath);
+
+	auto align = [](std::uint64_t offset)
+	{
+		return (offset + 7) & ~(std::uint64_t)7;
+	};
+	PackHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, packFileMagic, sizeof(header.magic));
+	header.version = packFileVersion;
+	header.pagesCount = (std::uint32_t)pageImages.size();
+	header.imagesCount = (std::uint32_t)atlas.getImagesCount();
+	header.filesCount = (std::uint32_t)files.size();
+	std::uint64_t offset = sizeof(PackHeader) + header.pagesCount * sizeof(PackPage) + header.imagesCount * sizeof(PackImage) +
+		header.filesCount * sizeof(PackFile);
+
+	std::vector<PackPage> pages(header.pagesCount);
+	for (size_t i = 0; i < pages.size(); i++)
+	{
+		pages[i].width = pageImages[i].getSize().x;
+		pages[i].height = pageImages[i].getSize().y;
+		pages[i].offset = offset = align(offset);
+		offset += (std::uint64_t)pages[i].width * pages[i].height * 4;
+	}
+
+	std::vector<PackImage> images(header.imagesCount);
+	for (int i = 0; i < (int)images.size(); i++)
+	{
+		TextureHandle handle(i);
+		std::string name = atlas.getName(handle);
+		const std::string& imagePath = atlas.getPath(handle);
+		if (name.size() >= sizeof(images[i].name) || imagePath.size() >= sizeof(images[i].path))
+		{
+			std::cerr << "name too long for asset pack: " << imagePath << std::endl;
+			return 1;
+		}
+		std::memset(&images[i], 0, sizeof(PackImage));
+		std::strcpy(images[i].name, name.c_str());
+		std::strcpy(images[i].path, imagePath.c_str());
+		const AtlasRegion& region = atlas.getRegion(handle);
+		images[i].page = region.page;
+		images[i].left = region.rect.left;
+		images[i].top = region.rect.top;
+		images[i].width = region.rect.width;
+		images[i].height = region.rect.height;
+		images[i].maskWords = (std::uint32_t)atlas.getMask(handle).bits.size();
+		images[i].maskOffset = offset = align(offset);
+		offset += images[i].maskWords * 8;
+	}
+
+	std::vector<PackFile> packFiles(header.filesCount);
+	std::vector<std::vector<char>> contents;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		std::ifstream file(files[i], std::ios::binary);
+		contents.push_back(std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()));
+		std::memset(&packFiles[i], 0, sizeof(PackFile));
+		std::strcpy(packFiles[i].path, files[i].c_str());
+		packFiles[i].offset = offset = align(offset);
+		packFiles[i].size = contents.back().size();
+		offset += packFiles[i].size;
+	}
+
+	std::ofstream file(path, std::ios::binary);
+	auto writeAt = [&file](std::uint64_t position, const void* data, size_t size)
+	{
+		static const char zeros[8] = {};
+		file.write(zeros, (std::streamsize)(position - (std::uint64_t)file.tellp()));
+		file.write((const char*)data, size);
+	};
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)pages.data(), pages.size() * sizeof(PackPage));
+	file.write((const char*)images.data(), images.size() * sizeof(PackImage));
+	file.write((const char*)packFiles.data(), packFiles.size() * sizeof(PackFile));
+	for (size_t i = 0; i < pages.size(); i++)
+		writeAt(pages[i].offset, pageImages[i].getPixelsPtr(), (size_t)pages[i].width * pages[i].height * 4);
+	for (int i = 0; i < (int)images.size(); i++)
+		writeAt(images[i].maskOffset, atlas.getMask(TextureHandle(i)).bits.data(), images[i].maskWords * 8);
+	for (size_t i = 0; i < packFiles.size(); i++)
+		writeAt(packFiles[i].offset, contents[i].data(), contents[i].size());
+	if (!file)
+	{
+		std::cerr << "cannot write asset pack " << path << std::endl;
+		return 1;
+	}
+	std::cout << "packed " << header.imagesCount << " images on " << header.pagesCount << " pages and " << header.filesCount
+		<< " files into " << path << " (" << offset << " bytes)" << std::endl;
+	return 0;
+}
+
+void updateBullets()
+{
+	bullets.update();
+}
+
+ChunkResults<int> enemyShots;
+
+// systemy wrogów przechodzą po tablicach komponentów kolejnych kawałków archetypu
+void updateEnemys()
+{
+	enemys.removeIf([](EnemyChunk& components, int i)
+	{
+		return components.hp[i] == 0;
+	});
+
+	// ruch równolegle; strzały są wykonywane potem w kolejności wrogów, żeby kolejność pocisków nie zależała od wątków
+	enemyShots.reset(JobSystem::getChunksCount(enemys.size(), ENEMYS_CHUNK_SIZE), ENEMYS_CHUNK_SIZE);
+	jobs.parallelFor(enemys.size(), ENEMYS_CHUNK_SIZE, [&](int chunk, int begin, int end)
+	{
+		EnemyChunk& components = enemys.getChunk(chunk);
+		const float step = deltaTime;
+		for (int i = 0; i < end - begin; i++)
+		{
+			components.prevY[i] = components.y[i];
+			components.y[i] += components.speed[i] * step;
+
+			components.timeFromLastBullet[i] += step;
+			if (components.timeFromLastBullet[i] >= components.shootingSpeed[i])
+			{
+				components.timeFromLastBullet[i] = 0;
+				enemyShots[chunk].push_back(begin + i);
+			}
+		}
+	});
+	enemyShots.forEach([&](int enemy)
+	{
+		enemys.shoot(enemy);
+	});
+
+	int escaped = enemys.removeIf([](EnemyChunk& components, int i)
+	{
+		return components.y[i] >= 700;
+	});
+	for (int i = 0; i < escaped; i++)
+		player.takeDamage(1);
+}
+
+void updatePlayer()
+{
+	player.update();
+}
+
+// muzyka jest strumieniowana: sf::Music dekoduje na własnym wątku po kilka małych buforów naraz,
+// więc w pamięci nie leży cały plik, a zapętlanie nie wymaga sprawdzania stanu co klatkę
+sf::Music music;
+std::string musicPath;
+void startBackgroundMusic()
+{
+	for (const char* path : musicPaths)
+	{
+		const PackFile* packed = findPackedFile(path);
+		if (packed != nullptr ? music.openFromMemory(assetPack.data() + packed->offset, (size_t)packed->size) : music.openFromFile(path))
+		{
+			musicPath = path;
+			music.setLoop(true);
+			music.play();
+			return;
+		}
+	}
+}
+
+void updateLevel()
+{
+	levelManager.updateLevel();
+}
+
+class SimulationPhase
+{
+public:
+	const char* name;
+	void (*update)();
+};
+
+// kolejność faz jednej klatki - wspólna dla gry, trybu headless i benchmarku
+const SimulationPhase simulationPhases[] = {
+	{ "updateLevel", updateLevel },
+	{ "updateCollisions", updateCollisions },
+	{ "updatePlayer", updatePlayer },
+	{ "updateBullets", updateBullets },
+	{ "updateEnemys", updateEnemys }
+};
+const int simulationPhasesCount = sizeof(simulationPhases) / sizeof(simulationPhases[0]);
+
+// fazy mierzone przez profiler; fazy symulacji zajmują kolejne numery od PROFILE_SIMULATION
+const int PROFILE_EVENTS = 0;
+const int PROFILE_SIMULATION = 1;
+const int PROFILE_MENU_UPDATE = PROFILE_SIMULATION + simulationPhasesCount;
+const int PROFILE_DRAW = PROFILE_MENU_UPDATE + 1;
+const int PROFILE_MENU_DRAW = PROFILE_DRAW + 1;
+const int PROFILE_DISPLAY = PROFILE_MENU_DRAW + 1;
+const int PROFILE_SLEEP = PROFILE_DISPLAY + 1;
+const int PROFILE_PHASES_COUNT = PROFILE_SLEEP + 1;
+
+#define PROFILE_HISTORY 240
+
+// czasy faz z ostatnich PROFILE_HISTORY klatek, nakładka z wykresem (F3) i zapis każdej klatki do CSV (F4)
+class FrameProfiler
+{
+public:
+	FrameProfiler()
+		:enabled_(false), overlayVisible_(false), fontLoaded_(false), frame_(0), steps_(0), lastSteps_(0), enemysCount_(0), bulletsCount_(0),
+		inputLatency_(0), history_(), bars_(sf::Quads)
+	{
+		for (auto& time : current_)
+			time = 0;
+	}
+
+	bool isEnabled()
+	{
+		return enabled_;
+	}
+
+	void setEnabled(bool enabled)
+	{
+		enabled_ = enabled;
+	}
+
+	// wywoływane z wątku symulacji i z wątku rysowania, dlatego liczniki są atomowe (w nanosekundach)
+	void add(int phase, double microseconds)
+	{
+		current_[phase] += (std::int64_t)(microseconds * 1000);
+	}
+
+	void addStep()
+	{
+		steps_++;
+	}
+
+	// wątek rysowania, raz na klatkę
+	void setInputLatency(sf::Int64 microseconds)
+	{
+		inputLatency_ = microseconds;
+	}
+
+	// zamyka bieżącą klatkę: zapisuje ją w historii i w CSV, po czym zeruje liczniki
+	void endFrame(int enemysCount, int playerBulletsCount, int enemyBulletsCount)
+	{
+		if (!enabled_)
+			return;
+
+		double* row = history_[frame_ % PROFILE_HISTORY];
+		for (int phase = 0; phase < PROFILE_PHASES_COUNT; phase++)
+			row[phase] = current_[phase].exchange(0) / 1000.0;
+		lastSteps_ = steps_.exchange(0);
+		enemysCount_ = enemysCount;
+		bulletsCount_ = playerBulletsCount + enemyBulletsCount;
+
+		if (csv_.is_open())
+		{
+			csv_ << frame_ << "," << lastSteps_ << "," << enemysCount << "," << playerBulletsCount << "," << enemyBulletsCount;
+			for (int phase = 0; phase < PROFILE_PHASES_COUNT; phase++)
+				csv_ << "," << row[phase];
+			csv_ << "\n";
+		}
+
+		frame_++;
+	}
+
+	const char* getPhaseName(int phase)
+	{
+		if (phase >= PROFILE_SIMULATION && phase < PROFILE_MENU_UPDATE)
+			return simulationPhases[phase - PROFILE_SIMULATION].name;
+
+		switch (phase)
+		{
+		case PROFILE_EVENTS: return "events";
+		case PROFILE_MENU_UPDATE: return "menuUpdate";
+		case PROFILE_DRAW: return "draw";
+		case PROFILE_MENU_DRAW: return "menuDraw";
+		case PROFILE_DISPLAY: return "display";
+		default: return "sleep";
+		}
+	}
+
+	bool isCsvOpen()
+	{
+		return csv_.is_open();
+	}
+
+	void openCsv(const std::string& path)
+	{
+		csv_.open(path);
+		if (!csv_)
+		{
+			std::cerr << "cannot write profile " << path << std::endl;
+			return;
 		}
-		else if (menuState_ == EMainMenuState::LEVELS_MENU)
+		csv_ << "frame,steps,enemys,playerBullets,enemyBullets";
+		for (int phase = 0; phase < PROFILE_PHASES_COUNT; phase++)
+			csv_ << "," << getPhaseName(phase);
+		csv_ << "\n";
+		std::cout << "profiling to " << path << std::endl;
+	}
+
+	void closeCsv()
+	{
+		csv_.close();
+	}
+
+	void toggleOverlay()
+	{
+		overlayVisible_ = !overlayVisible_;
+		if (overlayVisible_ && !fontLoaded_)
 		{
-			drawObject(level1Button_.getSprite(), level1Button_.getPosition());
-			drawObject(level2Button_.getSprite(), level2Button_.getPosition());
-			drawObject(level3Button_.getSprite(), level3Button_.getPosition());
-			drawObject(exit2Button_.getSprite(), exit2Button_.getPosition());
+			// czcionka jest tylko do podpisów - bez niej nakładka pokazuje same wykresy, a liczniki trafiają do tytułu okna
+			for (const char* path : { "img/font.ttf", "C:/Windows/Fonts/consola.ttf", "C:/Windows/Fonts/arial.ttf",
+				"/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf" })
+				if (font_.loadFromFile(path))
+				{
+					fontLoaded_ = true;
+					break;
+				}
+			text_.setFont(font_);
+			text_.setCharacterSize(12);
+			text_.setPosition(8, 8);
 		}
-		else if (menuState_ == EMainMenuState::GAME_OVER)
+	}
+
+	// bez czcionki podsumowanie trafia do tytułu okna, dlatego potrzebne jest okno, a nie dowolny RenderTarget
+	void drawOverlay(sf::RenderWindow& target)
+	{
+		if (!overlayVisible_)
+			return;
+
+		// każda klatka to słupek złożony z faz; wysokość graphHeight odpowiada dwóm krokom symulacji
+		const float graphLeft = 1000 - PROFILE_HISTORY * 2 - 8, graphBottom = 700 - 8, graphHeight = 120;
+		const double frameBudget = deltaTime * 1000000.0;
+		const float scale = (float)(graphHeight / (frameBudget * 2));
+
+		bars_.clear();
+		addRect(graphLeft, graphBottom - graphHeight, PROFILE_HISTORY * 2.f, graphHeight, sf::Color(0, 0, 0, 160));
+		for (int i = 0; i < PROFILE_HISTORY && i < frame_; i++)
 		{
-			drawObject(gameOver_, Vector2f(0, 0));
+			const double* row = history_[(frame_ - 1 - i) % PROFILE_HISTORY];
+			float x = graphLeft + (PROFILE_HISTORY - 1 - i) * 2.f;
+			float y = graphBottom;
+			for (int phase = 0; phase < PROFILE_PHASES_COUNT && y > graphBottom - graphHeight; phase++)
+			{
+				float height = std::min((float)row[phase] * scale, y - (graphBottom - graphHeight));
+				addRect(x, y - height, 2, height, getPhaseColor(phase));
+				y -= height;
+			}
+		}
+		addRect(graphLeft, graphBottom - graphHeight / 2, PROFILE_HISTORY * 2.f, 1, sf::Color(255, 255, 255, 200));
+		target.draw(bars_);
+
+		std::ostringstream info;
+		info << std::fixed << std::setprecision(0) << "enemys " << enemysCount_ << "  bullets " << bulletsCount_ << "  steps " << lastSteps_ << "  input " << inputLatency_ << " us";
+		const double* last = history_[(frame_ + PROFILE_HISTORY - 1) % PROFILE_HISTORY];
+		if (!fontLoaded_)
+		{
+			if (frame_ % 60 == 0)
+				target.setTitle("(Space invaders)-like game | " + info.str());
+			return;
+		}
+		for (int phase = 0; phase < PROFILE_PHASES_COUNT; phase++)
+			info << "\n" << getPhaseName(phase) << " " << last[phase] << " us";
+		text_.setString(info.str());
+		target.draw(text_);
+	}
+
+private:
+	void addRect(float x, float y, float width, float height, sf::Color color)
+	{
+		bars_.append(sf::Vertex(sf::Vector2f(x, y), color));
+		bars_.append(sf::Vertex(sf::Vector2f(x + width, y), color));
+		bars_.append(sf::Vertex(sf::Vector2f(x + width, y + height), color));
+		bars_.append(sf::Vertex(sf::Vector2f(x, y + height), color));
+	}
+
+	sf::Color getPhaseColor(int phase)
+	{
+		static const sf::Color colors[] = { sf::Color(120, 120, 120), sf::Color(230, 80, 80), sf::Color(240, 160, 60),
+			sf::Color(240, 230, 80), sf::Color(120, 220, 90), sf::Color(60, 200, 200), sf::Color(80, 120, 240),
+			sf::Color(170, 90, 230), sf::Color(230, 90, 190), sf::Color(200, 200, 200), sf::Color(60, 60, 60) };
+		return colors[phase % (sizeof(colors) / sizeof(colors[0]))];
+	}
+
+	bool enabled_;
+	bool overlayVisible_;
+	bool fontLoaded_;
+	int frame_;
+	std::atomic<int> steps_;
+	int lastSteps_;
+	int enemysCount_;
+	int bulletsCount_;
+	sf::Int64 inputLatency_;
+	std::atomic<std::int64_t> current_[PROFILE_PHASES_COUNT];
+	double history_[PROFILE_HISTORY][PROFILE_PHASES_COUNT];
+	std::ofstream csv_;
+	sf::VertexArray bars_;
+	sf::Font font_;
+	sf::Text text_;
+};
+FrameProfiler profiler;
+
+// mierzy czas od konstrukcji do końca zakresu i dolicza go do fazy profilera
+class ScopedTimer
+{
+public:
+	ScopedTimer(int phase)
+		:phase_(phase), enabled_(profiler.isEnabled())
+	{
+		if (enabled_)
+			start_ = std::chrono::steady_clock::now();
+	}
+
+	~ScopedTimer()
+	{
+		if (enabled_)
+			profiler.add(phase_, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start_).count());
+	}
+
+private:
+	int phase_;
+	bool enabled_;
+	std::chrono::steady_clock::time_point start_;
+};
+
+// jedna klatka logiki gry - nie dotyka okna, więc działa też w trybie headless
+void simulateFrame()
+{
+	for (int phase = 0; phase < simulationPhasesCount; phase++)
+	{
+		ScopedTimer timer(PROFILE_SIMULATION + phase);
+		simulationPhases[phase].update();
+	}
+}
+
+// FNV-1a po całym stanie symulacji - zapisywany w nagraniu co krok, żeby odtworzenie wykryło pierwszą rozbieżność
+class StateHash
+{
+public:
+	StateHash()
+		:value(14695981039346656037ull)
+	{ }
+
+	void add(const void* data, size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+			value = (value ^ bytes[i]) * 1099511628211ull;
+	}
+
+	void add(float number)
+	{
+		add(&number, sizeof(number));
+	}
+
+	void add(int number)
+	{
+		add(&number, sizeof(number));
+	}
+
+	std::uint64_t value;
+};
+
+std::uint64_t hashWorldState()
+{
+	StateHash hash;
+	hash.add(levelManager.getCurrentTime());
+	hash.add(levelManager.getNextRecord());
+	hash.add(player.getPostion().x);
+	hash.add(player.getPostion().y);
+	hash.add(player.getHp());
+	hash.add(player.getTimeFromLastBullet());
+
+	hash.add(enemys.size());
+	for (int i = 0; i < enemys.size(); i++)
+	{
+		hash.add(enemys.getPosition(i).x);
+		hash.add(enemys.getPosition(i).y);
+		hash.add(enemys.getHp(i));
+		hash.add(enemys.getTimeFromLastBullet(i));
+	}
+
+	for (BulletLane* lane : { &bullets.playerBullets, &bullets.enemyBullets })
+	{
+		hash.add(lane->size());
+		for (int i = 0; i < lane->size(); i++)
+		{
+			hash.add(lane->getPosition(i).x);
+			hash.add(lane->getPosition(i).y);
+			hash.add((int)lane->isAlive(i));
+		}
+	}
+	return hash.value;
+}
+
+// cały stan świata potrzebny do dalszej symulacji, bez sprite'ów i tekstur - same liczby kopiowane blokami.
+// Wektory zachowują pojemność między zapisami, więc ponowny zapis do tego samego obiektu zwykle nie alokuje pamięci.
+class WorldSnapshot
+{
+public:
+	WorldSnapshot()
+		:valid(false), tick(0), playerPosition(0, 0), playerHp(0), playerTimeFromLastBullet(0)
+	{ }
+
+	bool valid;
+	// liczba kroków od początku poziomu
+	long tick;
+	LevelManager::State level;
+	MainMenu::State menu;
+	Vector2f playerPosition;
+	int playerHp;
+	float playerTimeFromLastBullet;
+	EnemyStore::State enemys;
+	BulletLane::State playerBullets;
+	BulletLane::State enemyBullets;
+};
+
+int currentLevel = 1;
+long levelTick = 0;
+
+void saveWorld(WorldSnapshot& snapshot)
+{
+	snapshot.valid = true;
+	snapshot.tick = levelTick;
+	levelManager.save(snapshot.level);
+	mainMenu.save(snapshot.menu);
+	snapshot.playerPosition = player.getPostion();
+	snapshot.playerHp = player.getHp();
+	snapshot.playerTimeFromLastBullet = player.getTimeFromLastBullet();
+	enemys.save(snapshot.enemys);
+	bullets.playerBullets.save(snapshot.playerBullets);
+	bullets.enemyBullets.save(snapshot.enemyBullets);
+}
+
+// zapis musi pochodzić z aktualnie wczytanego poziomu
+void restoreWorld(const WorldSnapshot& snapshot)
+{
+	levelTick = snapshot.tick;
+	levelManager.restore(snapshot.level);
+	mainMenu.restore(snapshot.menu);
+	player.restoreState(snapshot.playerPosition, snapshot.playerHp, snapshot.playerTimeFromLastBullet);
+	enemys.restore(snapshot.enemys);
+	// zapis mógł powstać przed podmianą obrazków wrogów, a rozmiary mają odpowiadać obecnemu atlasowi
+	enemys.updateSizes();
+	bullets.playerBullets.restore(snapshot.playerBullets);
+	bullets.enemyBullets.restore(snapshot.enemyBullets);
+}
+
+// stan z początku wczytanego poziomu - ponowne podejście przywraca go zamiast wczytywać poziom od nowa
+WorldSnapshot levelStart;
+
+#define REWIND_SECONDS 30
+
+// zapisy świata z ostatnich REWIND_SECONDS sekund gry, po jednym na sekundę, od najstarszego do najnowszego
+class RewindBuffer
+{
+public:
+	RewindBuffer()
+		:enabled_(false), first_(0), count_(0)
+	{ }
+
+	bool isEnabled()
+	{
+		return enabled_;
+	}
+
+	void setEnabled(bool enabled)
+	{
+		enabled_ = enabled;
+	}
+
+	void clear()
+	{
+		count_ = 0;
+	}
+
+	// zapis co sekundę gry; gdy bufor jest pełny, nadpisywany jest najstarszy
+	void update()
+	{
+		long interval = std::max(1L, std::lround(1 / deltaTime));
+		if (!enabled_ || levelTick % interval != 0 || (count_ > 0 && getSlot(count_ - 1).tick == levelTick))
+			return;
+
+		if (count_ == REWIND_SECONDS)
+		{
+			first_ = (first_ + 1) % REWIND_SECONDS;
+			count_--;
+		}
+		saveWorld(getSlot(count_++));
+	}
+
+	// najnowszy zapis z tick <= tick albo nullptr; nowsze zapisy są odrzucane, bo po cofnięciu gra może potoczyć się inaczej
+	const WorldSnapshot* rewindTo(long tick)
+	{
+		while (count_ > 0 && getSlot(count_ - 1).tick > tick)
+			count_--;
+		return count_ > 0 ? &getSlot(count_ - 1) : nullptr;
+	}
+
+private:
+	WorldSnapshot& getSlot(int index)
+	{
+		return slots_[(first_ + index) % REWIND_SECONDS];
+	}
+
+	bool enabled_;
+	WorldSnapshot slots_[REWIND_SECONDS];
+	int first_;
+	int count_;
+};
+RewindBuffer rewindBuffer;
+
+// nagłówek pliku nagrania; po nim następuje ticks wpisów ReplayTick
+class ReplayHeader
+{
+public:
+	char magic[4];
+	std::uint32_t version;
+	std::int32_t level;
+	std::uint32_t seed;
+	float deltaTime;
+	std::uint32_t ticks;
+	float playerX;
+	float playerY;
+	std::int32_t playerHp;
+	float playerTimeFromLastBullet;
+};
+static_assert(sizeof(ReplayHeader) == 40, "ReplayHeader is stored on disk");
+
+class ReplayTick
+{
+#define REPLAY_LEFT 1
+#define REPLAY_RIGHT 2
+#define REPLAY_SHOOT 4
+#define REPLAY_MOUSE_LEFT 8
+
+public:
+	std::uint64_t stateHash;
+	std::int16_t mouseX;
+	std::int16_t mouseY;
+	std::uint8_t buttons;
+	std::uint8_t padding[3];
+};
+static_assert(sizeof(ReplayTick) == 16, "ReplayTick is stored on disk");
+
+const char replayFileMagic[4] = { 'S', 'I', 'R', 'P' };
+const std::uint32_t replayFileVersion = 1;
+
+ReplayTick encodeReplayTick(const InputState& input, std::uint64_t stateHash)
+{
+	ReplayTick tick;
+	std::memset(&tick, 0, sizeof(tick));
+	tick.stateHash = stateHash;
+	tick.mouseX = (std::int16_t)input.mouseX;
+	tick.mouseY = (std::int16_t)input.mouseY;
+	tick.buttons = (input.left ? REPLAY_LEFT : 0) | (input.right ? REPLAY_RIGHT : 0) |
+		(input.shoot ? REPLAY_SHOOT : 0) | (input.mouseLeft ? REPLAY_MOUSE_LEFT : 0);
+	return tick;
+}
+
+InputState decodeReplayTick(const ReplayTick& tick)
+{
+	InputState input;
+	input.left = (tick.buttons & REPLAY_LEFT) != 0;
+	input.right = (tick.buttons & REPLAY_RIGHT) != 0;
+	input.shoot = (tick.buttons & REPLAY_SHOOT) != 0;
+	input.mouseLeft = (tick.buttons & REPLAY_MOUSE_LEFT) != 0;
+	input.mouseX = tick.mouseX;
+	input.mouseY = tick.mouseY;
+	return input;
+}
+
+// nagrywa każde podejście do poziomu od loadLevel() do jego końca; plik zawiera zawsze ostatnie podejście
+class ReplayRecorder
+{
+public:
+	ReplayRecorder()
+		:recording_(false)
+	{ }
+
+	void setPath(const std::string& path)
+	{
+		path_ = path;
+	}
+
+	bool isRecording()
+	{
+		return recording_;
+	}
+
+	void start(int level)
+	{
+		if (path_.empty())
+			return;
+
+		std::memset(&header_, 0, sizeof(header_));
+		std::memcpy(header_.magic, replayFileMagic, sizeof(header_.magic));
+		header_.version = replayFileVersion;
+		header_.level = level;
+		header_.seed = randomSeed;
+		header_.deltaTime = deltaTime;
+		header_.playerX = player.getPostion().x;
+		header_.playerY = player.getPostion().y;
+		header_.playerHp = player.getHp();
+		header_.playerTimeFromLastBullet = player.getTimeFromLastBullet();
+		ticks_.clear();
+		// 10 minut gry bez dokładania pamięci w trakcie nagrywania
+		ticks_.reserve((size_t)(600 / deltaTime));
+		recording_ = true;
+	}
+
+	void addTick(const InputState& input, std::uint64_t stateHash)
+	{
+		ticks_.push_back(encodeReplayTick(input, stateHash));
+	}
+
+	void stop()
+	{
+		if (!recording_)
+			return;
+
+		recording_ = false;
+		header_.ticks = (std::uint32_t)ticks_.size();
+		std::ofstream file(path_, std::ios::binary);
+		file.write((const char*)&header_, sizeof(header_));
+		if (!ticks_.empty())
+			file.write((const char*)ticks_.data(), ticks_.size() * sizeof(ReplayTick));
+		if (!file)
+			std::cerr << "cannot write replay " << path_ << std::endl;
+	}
+
+	// po cofnięciu świata nagranie kończy się na kroku, do którego cofnięto
+	void truncate(long tick)
+	{
+		if (recording_ && (long)ticks_.size() > tick)
+			ticks_.resize(tick);
+	}
+
+private:
+	std::string path_;
+	bool recording_;
+	ReplayHeader header_;
+	std::vector<ReplayTick> ticks_;
+};
+ReplayRecorder recorder;
+
+class ReplayInput : public InputSource
+{
+public:
+	ReplayInput(const ReplayTick* ticks, int ticksCount)
+		:ticks_(ticks), ticksCount_(ticksCount), next_(0)
+	{ }
+
+	InputState read() override
+	{
+		if (next_ >= ticksCount_)
+			return InputState();
+		return decodeReplayTick(ticks_[next_++]);
+	}
+
+	void seek(int tick)
+	{
+		next_ = std::min(std::max(tick, 0), ticksCount_);
+	}
+
+private:
+	const ReplayTick* ticks_;
+	int ticksCount_;
+	int next_;
+};
+
+// jeden krok symulacji o długości deltaTime
+void updateFrame()
+{
+	currentInput = inputSource->read();
+	if (mainMenu.getMenuState() == EMainMenuState::NO_MENU)
+	{
+		rewindBuffer.update();
+		simulateFrame();
+		levelTick++;
+		if (recorder.isRecording())
+		{
+			recorder.addTick(currentInput, hashWorldState());
+			if (mainMenu.getMenuState() != EMainMenuState::NO_MENU)
+				recorder.stop();
 		}
-		else if (menuState_ == EMainMenuState::LEVEL_PASSED)
+	}
+	else
+	{
+		ScopedTimer timer(PROFILE_MENU_UPDATE);
+		mainMenu.update();
+	}
+}
+
+// cofa świat o co najmniej ticks kroków, do najbliższego zapisu w buforze; false, gdy bufor nie sięga tak daleko
+bool rewindWorld(long ticks)
+{
+	const WorldSnapshot* snapshot = rewindBuffer.rewindTo(levelTick - ticks);
+	if (snapshot == nullptr)
+		return false;
+	restoreWorld(*snapshot);
+	recorder.truncate(levelTick);
+	return true;
+}
+
+// ustawiane przez wątek rysowania (Backspace), obsługiwane przez wątek symulacji między krokami
+std::atomic<int> rewindRequests(0);
+
+// bufor potrójny bez blokad: pisarz zawsze ma własny slot, czytelnik trzyma ostatni opublikowany,
+// a trzeci slot jest wymieniany atomowo razem z bitem oznaczającym nową zawartość
+template <class T>
+class TripleBuffer
+{
+#define TRIPLE_BUFFER_FRESH 4
+
+public:
+	TripleBuffer()
+		:back_(0), middle_(1), front_(2)
+	{ }
+
+	T& getBack()
+	{
+		return slots_[back_];
+	}
+
+	void publish()
+	{
+		back_ = middle_.exchange(back_ | TRIPLE_BUFFER_FRESH) & 3;
+	}
+
+	// zwraca najnowszy opublikowany slot; slot pozostaje niezmieniony aż do następnego wywołania
+	const T& acquire()
+	{
+		if (middle_ & TRIPLE_BUFFER_FRESH)
+			front_ = middle_.exchange(front_) & 3;
+		return slots_[front_];
+	}
+
+private:
+	T slots_[3];
+	int back_;
+	std::atomic<int> middle_;
+	int front_;
+};
+
+class SnapshotSprite
+{
+public:
+	SnapshotSprite(const sf::Sprite& sprite, Vector2f prevPosition, Vector2f position)
+		:texture(sprite.getTexture()), rect(sprite.getTextureRect()), prevPosition(prevPosition), position(position)
+	{ }
+
+	SnapshotSprite(TextureHandle handle, Vector2f prevPosition, Vector2f position)
+		:texture(nullptr), prevPosition(prevPosition), position(position)
+	{
+		if (!handle.isValid())
+			return;
+		const AtlasRegion& region = atlas.getRegion(handle);
+		texture = &atlas.getPage(region.page);
+		rect = region.rect;
+	}
+
+	const sf::Texture* texture;
+	sf::IntRect rect;
+	Vector2f prevPosition;
+	Vector2f position;
+};
+
+#define SNAPSHOT_LAYERS 3
+
+// wszystko, czego wątek rysowania potrzebuje z jednego kroku symulacji; warstwy: gracz, pociski, wrogowie
+class RenderSnapshot
+{
+public:
+	RenderSnapshot()
+		:menuState(EMainMenuState::START_MENU), menuVersion(0), playerHp(0), hpVersion(0), enemysCount(0), playerBulletsCount(0), enemyBulletsCount(0)
+	{ }
+
+	EMainMenuState menuState;
+	std::uint32_t menuVersion;
+	int playerHp;
+	std::uint32_t hpVersion;
+	std::vector<SnapshotSprite> layers[SNAPSHOT_LAYERS];
+	int enemysCount;
+	int playerBulletsCount;
+	int enemyBulletsCount;
+	std::chrono::steady_clock::time_point time;
+};
+TripleBuffer<RenderSnapshot> snapshots;
+
+void addSnapshotSprite(std::vector<SnapshotSprite>& layer, const sf::Sprite& sprite, Vector2f prevPosition, Vector2f position)
+{
+	layer.push_back(SnapshotSprite(sprite, prevPosition, position));
+}
+
+// wektory migawek zachowują pojemność, więc po rozgrzaniu publikowanie nie alokuje pamięci
+void publishSnapshot()
+{
+	RenderSnapshot& snapshot = snapshots.getBack();
+	for (auto& layer : snapshot.layers)
+		layer.clear();
+
+	snapshot.menuState = mainMenu.getMenuState();
+	snapshot.menuVersion = mainMenu.getVersion();
+	snapshot.playerHp = player.getHp();
+	snapshot.hpVersion = player.getHpVersion();
+	addSnapshotSprite(snapshot.layers[0], player.getSprite(), player.getInterpolatedPosition(0), player.getPostion());
+
+	for (BulletLane* lane : { &bullets.playerBullets, &bullets.enemyBullets })
+		for (int i = 0; i < lane->size(); i++)
+			addSnapshotSprite(snapshot.layers[1], lane->getSprite(), lane->getInterpolatedPosition(i, 0), lane->getPosition(i));
+
+	for (int i = 0; i < enemys.size(); i++)
+		snapshot.layers[2].push_back(SnapshotSprite(enemys.getTexture(i), enemys.getPrevPosition(i), enemys.getPosition(i)));
+
+	snapshot.enemysCount = enemys.size();
+	snapshot.playerBulletsCount = bullets.playerBullets.size();
+	snapshot.enemyBulletsCount = bullets.enemyBullets.size();
+	snapshot.time = std::chrono::steady_clock::now();
+	snapshots.publish();
+}
+
+// pozwala wątkowi rysowania zatrzymać wątek symulacji między krokami, np. żeby podmienić dane używane przez oba wątki
+class SimulationGate
+{
+public:
+	SimulationGate()
+		:running_(false), requested_(false), paused_(false)
+	{ }
+
+	void setRunning(bool running)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		running_ = running;
+		changed_.notify_all();
+	}
+
+	// wątek rysowania: wraca, gdy symulacja stoi między krokami (albo nie działa)
+	void pause()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		requested_ = true;
+		changed_.wait(lock, [this]() { return paused_ || !running_; });
+	}
+
+	void resume()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		requested_ = false;
+		changed_.notify_all();
+	}
+
+	// wątek symulacji, między krokami
+	void check()
+	{
+		if (!requested_)
+			return;
+		std::unique_lock<std::mutex> lock(mutex_);
+		paused_ = true;
+		changed_.notify_all();
+		changed_.wait(lock, [this]() { return !requested_; });
+		paused_ = false;
+	}
+
+private:
+	std::mutex mutex_;
+	std::condition_variable changed_;
+	bool running_;
+	std::atomic<bool> requested_;
+	bool paused_;
+};
+SimulationGate simulationGate;
+
+// wątek symulacji: stały krok niezależny od rysowania - czas trafia do akumulatora, z którego wykonywane są
+// kolejne kroki po deltaTime; blokowanie display() na vsync nie opóźnia już logiki gry
+void runSimulation()
+{
+	const float maxFrameTime = 0.25f;
+	const int maxStepsPerFrame = 16;
+	sf::Clock clock;
+	float accumulator = 0;
+	publishSnapshot();
+	while (!quitRequested)
+	{
+		simulationGate.check();
+		accumulator += std::min(clock.restart().asSeconds(), maxFrameTime);
+		int steps = 0;
+		// każde naciśnięcie cofa grę o sekundę
+		int rewinds = rewindRequests.exchange(0);
+		if (rewinds > 0 && mainMenu.getMenuState() == EMainMenuState::NO_MENU)
+			rewindWorld(rewinds * std::lround(1 / deltaTime));
+		while (accumulator >= deltaTime && steps < maxStepsPerFrame)
 		{
-			drawObject(levelPassed_, Vector2f(0, 0));
+			updateFrame();
+			publishSnapshot();
+			profiler.addStep();
+			accumulator -= deltaTime;
+			steps++;
 		}
+		// gdy komputer nie nadąża, gra zwalnia zamiast nadrabiać coraz większą liczbą kroków
+		if (steps == maxStepsPerFrame)
+			accumulator = std::min(accumulator, deltaTime);
+
+		sf::sleep(sf::seconds(deltaTime - accumulator));
 	}
+	simulationGate.setRunning(false);
+}
 
-	EMainMenuState getMenuState()
+sf::Sprite backgroundSprite;
+
+// warstwa rysowana raz do własnej tekstury i potem tylko kopiowana na ekran; redraw jest wywoływane dopiero,
+// gdy zmieni się numer wersji rysowanego stanu
+class RetainedLayer
+{
+public:
+	RetainedLayer()
+		:created_(false), drawn_(false), version_(0)
+	{ }
+
+	void invalidate()
 	{
-		return menuState_;
+		drawn_ = false;
 	}
 
-	void setMenuState(EMainMenuState type)
+	void draw(sf::RenderTarget& target, std::uint32_t version, const std::function<void(sf::RenderTarget&)>& redraw)
 	{
-		menuState_ = type;
-		endSceeenTimer_ = 5;
+		if (!created_)
+		{
+			created_ = texture_.create(1000, 700);
+			if (!created_)
+				return;
+			sprite_.setTexture(texture_.getTexture(), true);
+		}
+		if (!drawn_ || version != version_)
+		{
+			texture_.clear(sf::Color::Transparent);
+			redraw(texture_);
+			texture_.display();
+			drawn_ = true;
+			version_ = version;
+		}
+		target.draw(sprite_);
 	}
 
 private:
-	EMainMenuState menuState_;
+	sf::RenderTexture texture_;
+	sf::Sprite sprite_;
+	bool created_;
+	bool drawn_;
+	std::uint32_t version_;
+};
+RetainedLayer backgroundLayer;
+RetainedLayer hudLayer;
+RetainedLayer menuLayer;
 
-	Button startButton_;
-	Button exitButton_;
+// ustawia tekstury wszystkich sprite'ów z atlasu - przy starcie i po podmianie obrazków
+void setSpritesTextures()
+{
+	setSpriteTexture(backgroundSprite, "bg");
+	player.setTexture("player");
+	player.setHpTexture("heart");
+	bullets.setTextures();
+	mainMenu.setButtonsTextures();
+}
 
-	Button level1Button_;
-	Button level2Button_;
-	Button level3Button_;
-	Button exit2Button_;
+// pozycje są interpolowane między dwoma ostatnimi krokami zawartymi w migawce
+void drawSnapshot(const RenderSnapshot& snapshot)
+{
+	float alpha = std::chrono::duration<float>(std::chrono::steady_clock::now() - snapshot.time).count() / deltaTime;
+	alpha = std::min(alpha, 1.f);
 
-	sf::Sprite gameOver_;
-	sf::Sprite levelPassed_;
+	backgroundLayer.draw(*window, 0, [](sf::RenderTarget& target)
+	{
+		target.draw(backgroundSprite);
+	});
+	if (snapshot.menuState == EMainMenuState::NO_MENU)
+	{
+		ScopedTimer timer(PROFILE_DRAW);
+		for (auto& layer : snapshot.layers)
+		{
+			for (auto& sprite : layer)
+			{
+				Vector2f position(sprite.prevPosition.x + (sprite.position.x - sprite.prevPosition.x) * alpha,
+					sprite.prevPosition.y + (sprite.position.y - sprite.prevPosition.y) * alpha);
+				spriteBatch.add(sprite.texture, sprite.rect, position);
+			}
+			spriteBatch.draw(*window);
+		}
+		hudLayer.draw(*window, snapshot.hpVersion, [&](sf::RenderTarget& target)
+		{
+			for (int i = 0; i < snapshot.playerHp; i++)
+				drawObject(player.getHpSprite(), Vector2f(10 + 25 * i, 670));
+			spriteBatch.draw(target);
+		});
+	}
+	else
+	{
+		ScopedTimer timer(PROFILE_MENU_DRAW);
+		menuLayer.draw(*window, snapshot.menuVersion, [&](sf::RenderTarget& target)
+		{
+			mainMenu.draw(snapshot.menuState);
+			spriteBatch.draw(target);
+		});
+	}
+}
 
-	float endSceeenTimer_;
-};
+// ilu wrogów może być naraz na wczytanym poziomie
+int getLevelEnemysCount()
+{
+	return currentLevel == ENDLESS_LEVEL ? ENDLESS_RESERVED_ENEMYS : levelManager.getRecordsCount();
+}
 
-MainMenu mainMenu;
+void loadLevel(int level)
+{
+	if (level == ENDLESS_LEVEL)
+	{
+		levelManager.startEndless(randomSeed);
+	}
+	else
+	{
+		std::string path = "levels/level" + std::to_string(level);
+		levelManager.load(path + ".lvl", path + ".txt");
+	}
+	currentLevel = level;
+	// wszyscy wrogowie poziomu mieszczą się w pamięci przydzielonej tutaj, więc ich pojawianie się nie alokuje
+	enemys.reserve(getLevelEnemysCount());
+	collisionGrid.reserve(getLevelEnemysCount());
+	levelTick = 0;
+	rewindBuffer.clear();
+	saveWorld(levelStart);
+	recorder.start(level);
+}
 
-class LevelManager
+// ponowne podejście do wczytanego poziomu: przywrócenie zapisu z jego początku zamiast clear() i wczytywania pliku
+void restartLevel()
+{
+	restoreWorld(levelStart);
+	rewindBuffer.clear();
+	recorder.start(currentLevel);
+}
+
+// poziom wybrany w menu; ten sam poziom co ostatnio nie jest wczytywany ponownie
+void startLevel(int level)
+{
+	if (level == currentLevel && levelStart.valid)
+		restartLevel();
+	else
+		loadLevel(level);
+}
+
+// obserwuje pliki gry: inotify na Linuksie, gdzie indziej sprawdzanie czasów modyfikacji co pół sekundy. Zmienione obrazki
+// są dekodowane na wątku obserwatora, a applyChanges() podmienia je między klatkami przy zatrzymanej symulacji.
+class AssetWatcher
 {
 public:
-	LevelManager()
-		:objects_(), currentTime_(0) 
+	AssetWatcher()
+		:running_(false), changed_(false)
 	{ }
 
-	void addObject(LevelObjectInfo levelObjectInfo)
+	~AssetWatcher()
 	{
-		objects_.push(levelObjectInfo);
+		stop();
 	}
 
-	void clear()
+	// directories - obserwowane przez inotify, files - sprawdzane, gdy inotify nie jest dostępne
+	void start(const std::vector<std::string>& directories, const std::vector<std::string>& files)
 	{
-		while (objects_.empty() == false)
-			objects_.pop();
-
-		enemys.clear();
-		bullets.clear();
-
-		currentTime_ = 0;
+		directories_ = directories;
+		files_ = files;
+		running_ = true;
+		thread_ = std::thread([this]()
+		{
+			if (!watchDirectories())
+				pollFiles();
+		});
 	}
 
-	void updateLevel()
+	void stop()
 	{
-		if (player.getHp() <= 0)
 		{
-			mainMenu.setMenuState(EMainMenuState::GAME_OVER);
-			player.refillHp();
+			std::lock_guard<std::mutex> lock(mutex_);
+			running_ = false;
 		}
-		else if (enemys.size() == 0 && objects_.size() == 0)
+		stopped_.notify_all();
+		if (thread_.joinable())
+			thread_.join();
+	}
+
+	// wątek rysowania, raz na klatkę
+	void applyChanges()
+	{
+		if (!changed_)
+			return;
+
+		std::vector<ReloadedImage> images;
+		std::vector<std::string> files;
 		{
-			mainMenu.setMenuState(EMainMenuState::LEVEL_PASSED);
-			player.refillHp();
+			std::lock_guard<std::mutex> lock(mutex_);
+			images.swap(images_);
+			files.swap(changedFiles_);
+			changed_ = false;
 		}
 
-		currentTime_ += deltaTime;
-		while (objects_.empty() == false && objects_.front().spawnTime <= currentTime_)
+		simulationGate.pause();
+		for (auto& reloaded : images)
 		{
-			LevelObjectInfo info = objects_.front();
-			Enemy enemy = info.builder.create(info.startX);
-			enemy.setPosition(enemy.getPostion() - enemy.getSize()*0.5);
-			enemys.push_back(enemy);
-			objects_.pop();
+			atlas.replaceImage(reloaded.handle, reloaded.image, reloaded.mask);
+			std::cout << "reloaded " << atlas.getPath(reloaded.handle) << std::endl;
 		}
+		if (!images.empty())
+		{
+			setSpritesTextures();
+			enemys.updateSizes();
+			// większy obrazek wroga zajmuje więcej komórek siatki - tablice trzeba powiększyć teraz, a nie w trakcie kroku
+			collisionGrid.reserve(getLevelEnemysCount());
+			backgroundLayer.invalidate();
+			hudLayer.invalidate();
+			menuLayer.invalidate();
+		}
+		for (auto& path : files)
+		{
+			if (path == musicPath)
+			{
+				music.stop();
+				if (music.openFromFile(musicPath))
+					music.play();
+				std::cout << "reloaded " << path << std::endl;
+			}
+			else if (path.compare(0, path.rfind('.'), "levels/level" + std::to_string(currentLevel)) == 0)
+			{
+				// grany poziom nie jest podmieniany w trakcie - następne podejście wczyta plik od nowa
+				levelStart.valid = false;
+				std::cout << "level " << path << " changed, reloaded on next start" << std::endl;
+			}
+		}
+		simulationGate.resume();
 	}
 
 private:
-	std::queue<LevelObjectInfo> objects_;
-	float currentTime_;
-};
-
-LevelManager levelManager;
-
-bool areObjectsCollide(Spaceship& spaceship, Bullet& bullet)
-{
-	auto spaceshipSize = spaceship.getSize();
-	auto bulletSize = bullet.getSprite().getTexture()->getSize();
-	auto spaceshipPos = spaceship.getPostion();
-	auto bulletPos = bullet.getPosition();
-
-	return (spaceshipPos.x <= bulletPos.x + bulletSize.x && spaceshipPos.x + spaceshipSize.x >= bulletPos.x) &&
-		(spaceshipPos.y <= bulletPos.y + bulletSize.y && spaceshipPos.y + spaceshipSize.y >= bulletPos.y);
-}
+	class ReloadedImage
+	{
+	public:
+		TextureHandle handle;
+		sf::Image image;
+		AlphaMask mask;
+	};
 
-void updateCollisions()
-{
-	// collisions with player
-	for (auto& bullet : bullets)
+	bool watchDirectories()
 	{
-		if (bullet.getDirection() == Direction::DOWN && areObjectsCollide(player, bullet))
+#ifdef __linux__
+		int file = inotify_init1(IN_NONBLOCK);
+		if (file < 0)
+			return false;
+		// katalog obserwowany pod numerem watch jest w watches[watch]
+		std::vector<std::string> watches;
+		for (auto& directory : directories_)
 		{
-			player.takeDamage(1);
-			bullet.kill();
+			int watch = inotify_add_watch(file, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+			if (watch < 0)
+				continue;
+			if ((int)watches.size() <= watch)
+				watches.resize(watch + 1);
+			watches[watch] = directory;
 		}
+
+		alignas(inotify_event) char buffer[4096];
+		while (running_)
+		{
+			pollfd descriptor = { file, POLLIN, 0 };
+			if (poll(&descriptor, 1, 200) <= 0)
+				continue;
+			ssize_t length = read(file, buffer, sizeof(buffer));
+			for (ssize_t offset = 0; offset < length;)
+			{
+				const inotify_event* event = (const inotify_event*)(buffer + offset);
+				if (event->len > 0 && event->wd < (int)watches.size() && !watches[event->wd].empty())
+					onFileChanged(watches[event->wd] + "/" + event->name);
+				offset += sizeof(inotify_event) + event->len;
+			}
+		}
+		::close(file);
+		return true;
+#else
+		return false;
+#endif
 	}
 
-	// collisions with enemys
-	for (auto& bullet : bullets)
+	void pollFiles()
 	{
-		for (auto& enemy : enemys)
+		std::vector<long long> times;
+		for (auto& path : files_)
+			times.push_back(getModificationTime(path));
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (!stopped_.wait_for(lock, std::chrono::milliseconds(500), [this]() { return !running_; }))
 		{
-			if (bullet.getDirection() == Direction::UP && areObjectsCollide(enemy, bullet))
+			lock.unlock();
+			for (size_t i = 0; i < files_.size(); i++)
 			{
-				enemy.takeDamage(10);
-				bullet.kill();
+				long long time = getModificationTime(files_[i]);
+				if (time != times[i])
+				{
+					times[i] = time;
+					onFileChanged(files_[i]);
+				}
 			}
+			lock.lock();
 		}
 	}
-}
 
-#include<iostream>
-void loadTexturesFromFiles()
-{
-	sf::Texture texture;
-	texture.loadFromFile("img\\player.png");
-	textures["player"] = texture;
-
-	texture.loadFromFile("img\\green-bullet.png");
-	textures["bullet_green"] = texture;
+	void onFileChanged(const std::string& path)
+	{
+		ReloadedImage reloaded;
+		reloaded.handle = atlas.findPath(path);
+		if (reloaded.handle.isValid())
+		{
+			// plik może być jeszcze zapisywany; następne zdarzenie spróbuje ponownie
+			if (!reloaded.image.loadFromFile(path))
+				return;
+			reloaded.mask.create(reloaded.image);
+		}
 
-	texture.loadFromFile("img\\red-bullet.png");
-	textures["bullet_red"] = texture;
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (reloaded.handle.isValid())
+			images_.push_back(std::move(reloaded));
+		else
+			changedFiles_.push_back(path);
+		changed_ = true;
+	}
 
-	texture.loadFromFile("img\\enemy1.png");
-	textures["enemy1"] = texture;
+	std::vector<std::string> directories_;
+	std::vector<std::string> files_;
+	std::thread thread_;
+	std::atomic<bool> running_;
+	std::mutex mutex_;
+	std::condition_variable stopped_;
+	std::vector<ReloadedImage> images_;
+	std::vector<std::string> changedFiles_;
+	std::atomic<bool> changed_;
+};
 
-	texture.loadFromFile("img\\enemy1-250.png");
-	textures["enemy1-250"] = texture;
+// symulacja bez okna: bot steruje graczem, a poziom jest restartowany po każdej wygranej lub przegranej;
+// w trybie bez końca gra toczy się dalej po przegranej, a co minutę czasu gry wypisywany jest raport do testów długich sesji
+int runHeadless(int level, long ticks, unsigned seed)
+{
+	RandomInput bot(seed);
+	inputSource = &bot;
+	loadLevel(level);
 
-	texture.loadFromFile("img\\enemy2.png");
-	textures["enemy2"] = texture;
+	long levelsPassed = 0;
+	long levelsFailed = 0;
+	int maxEnemys = 0;
+	size_t maxBullets = 0;
+	// alokacje są liczone tylko w krokach po rozgrzaniu, bez wczytywania poziomu przy restarcie
+	const long warmupTicks = 1000;
+	long long steadyAllocations = 0;
+	const long reportTicks = (long)(60 / deltaTime);
+	long long reportAllocations = allocationsCount;
+	sf::Clock clock;
+	sf::Clock reportClock;
+	for (long tick = 0; tick < ticks; tick++)
+	{
+		long long allocationsBefore = allocationsCount;
+		updateFrame();
+		if (tick >= warmupTicks)
+			steadyAllocations += allocationsCount - allocationsBefore;
+		maxEnemys = std::max(maxEnemys, enemys.size());
+		maxBullets = std::max(maxBullets, bullets.size());
 
-	texture.loadFromFile("img\\enemy3.png");
-	textures["enemy3"] = texture;
+		if (mainMenu.getMenuState() != EMainMenuState::NO_MENU)
+		{
+			if (mainMenu.getMenuState() == EMainMenuState::GAME_OVER)
+				levelsFailed++;
+			else
+				levelsPassed++;
+			if (level != ENDLESS_LEVEL)
+				restartLevel();
+			mainMenu.setMenuState(EMainMenuState::NO_MENU);
+		}
 
-	texture.loadFromFile("img\\enemy4.png");
-	textures["enemy4"] = texture;
+		if (level == ENDLESS_LEVEL && (tick + 1) % reportTicks == 0)
+		{
+			float seconds = reportClock.restart().asSeconds();
+			std::cout << "t " << (long)((tick + 1) * (double)deltaTime) << " s: " << (seconds > 0 ? reportTicks / seconds : 0) << " ticks/s, "
+				<< "enemys " << enemys.size() << ", bullets " << bullets.size() << ", spawned " << levelManager.getNextRecord()
+				<< ", allocations " << (allocationsCounted ? std::to_string(allocationsCount - reportAllocations) : "not counted") << std::endl;
+			reportAllocations = allocationsCount;
+		}
+	}
+	float seconds = clock.getElapsedTime().asSeconds();
+	recorder.stop();
 
-	texture.loadFromFile("img\\start.png");
-	textures["start_button"] = texture;
+	std::cout << "level " << (level == ENDLESS_LEVEL ? "endless" : std::to_string(level)) << ", seed " << seed << "\n"
+		<< "ticks: " << ticks << " in " << seconds << " s (" << (seconds > 0 ? ticks / seconds : 0) << " ticks/s)\n"
+		<< "levels passed: " << levelsPassed << ", failed: " << levelsFailed << "\n"
+		<< "max enemys: " << maxEnemys << ", max bullets: " << maxBullets << "\n"
+		<< "allocations after " << warmupTicks << " ticks: "
+		<< (allocationsCounted ? std::to_string(steadyAllocations) : "not counted (build with COUNT_ALLOCATIONS)") << std::endl;
+	return 0;
+}
 
-	texture.loadFromFile("img\\exit.png");
-	textures["exit_button"] = texture;
+class BenchmarkOptions
+{
+public:
+	BenchmarkOptions()
+		:counts({ 10, 1000, 10000, 100000 }), ticks(120), budgetSeconds(5), tolerance(0.2f),
+		baselinePath("bench_baseline.txt"), saveBaseline(false)
+	{ }
 
-	texture.loadFromFile("img\\level1.png");
-	textures["level1_button"] = texture;
+	std::vector<int> counts;
+	int ticks;
+	float budgetSeconds;
+	float tolerance;
+	std::string baselinePath;
+	bool saveBaseline;
+};
 
-	texture.loadFromFile("img\\level2.png");
-	textures["level2_button"] = texture;
+class PhaseStats
+{
+public:
+	PhaseStats()
+		:p50(0), p99(0), max(0)
+	{ }
 
-	texture.loadFromFile("img\\level3.png");
-	textures["level3_button"] = texture;
+	double p50;
+	double p99;
+	double max;
+};
 
-	texture.loadFromFile("img\\level_passed.png"); //tmp
-	textures["level_passed"] = texture;
+PhaseStats computePhaseStats(std::vector<double> samples)
+{
+	PhaseStats stats;
+	if (samples.empty())
+		return stats;
 
-	texture.loadFromFile("img\\game_over.png"); // tmp
-	textures["game_over"] = texture;
+	std::sort(samples.begin(), samples.end());
+	stats.p50 = samples[(samples.size() - 1) / 2];
+	stats.p99 = samples[std::min(samples.size() - 1, (size_t)(samples.size() * 0.99))];
+	stats.max = samples.back();
+	return stats;
+}
 
-	texture.loadFromFile("img\\heart.png");
-	textures["heart"] = texture;
+// zapełnia świat zadaną liczbą wrogów i pocisków rozrzuconych losowo po planszy
+void fillWorld(int count, std::mt19937& random)
+{
+	levelManager.clear();
+	player.refillHp();
+	for (int i = 0; i < count; i++)
+	{
+		int enemy = enemys.find(builders_[random() % builders_.size()].create(random() % 1000));
+		enemys.setPosition(enemy, Vector2f(enemys.getPosition(enemy).x, (float)(random() % 650)));
 
-	texture.loadFromFile("img\\bg_fin.png");
-	textures["bg"] = texture;
+		Direction direction = (i % 2 == 0) ? Direction::UP : Direction::DOWN;
+		bullets.getLane(direction).spawn((float)(random() % 1000), (float)(random() % 700));
+	}
 }
 
-void updateBullets()
+std::map<std::string, PhaseStats> loadBenchmarkBaseline(const std::string& path)
 {
-	for (int i = 0; i < bullets.size(); i++)
+	std::map<std::string, PhaseStats> baseline;
+	std::ifstream file(path);
+	std::string line;
+	while (std::getline(file, line))
 	{
-		if (!bullets[i].isAlive())
-		{
-			std::swap(bullets[i], bullets.back());
-			bullets.pop_back();
-			i--;
+		if (line.empty() || line[0] == '#')
 			continue;
-		}
-		bullets[i].update();
-		drawObject(bullets[i].getSprite(), bullets[i].getPosition());
+
+		std::istringstream fields(line);
+		std::string count, phase;
+		PhaseStats stats;
+		if (fields >> count >> phase >> stats.p50 >> stats.p99 >> stats.max)
+			baseline[count + " " + phase] = stats;
 	}
+	return baseline;
 }
 
-void updateEnemys()
+// mierzy czas każdej fazy klatki przy rosnącej liczbie obiektów; zwraca 1, gdy wyniki są gorsze od zapisanego baseline albo go brak
+int runBenchmark(const BenchmarkOptions& options, unsigned seed)
 {
-	for (int i = 0; i < enemys.size(); i++)
+	RandomInput bot(seed);
+	inputSource = &bot;
+	std::mt19937 random(seed);
+
+	auto baseline = loadBenchmarkBaseline(options.baselinePath);
+	// bez baseline porównanie niczego by nie sprawdziło - trzeba go najpierw zapisać na tej maszynie
+	if (!options.saveBaseline && baseline.empty())
+	{
+		std::cerr << "no baseline at " << options.baselinePath << ", run --bench --bench-save first" << std::endl;
+		return 1;
+	}
+	std::ostringstream results;
+	results << "# count phase p50_us p99_us max_us\n";
+	bool regressed = false;
+
+	std::cout << std::left << std::setw(8) << "count" << std::setw(18) << "phase"
+		<< std::right << std::setw(12) << "p50 us" << std::setw(12) << "p99 us" << std::setw(12) << "max us" << "\n";
+	for (int count : options.counts)
 	{
-		if (enemys[i].getHp() == 0)
+		std::vector<std::vector<double>> samples(simulationPhasesCount + 1);
+		sf::Clock budget;
+		int ticks = 0;
+		// świat jest odbudowywany przed każdą klatką, żeby każda mierzona klatka miała pełne obciążenie
+		while (ticks < options.ticks && (ticks == 0 || budget.getElapsedTime().asSeconds() < options.budgetSeconds))
 		{
-			std::swap(enemys[i], enemys.back());
-			enemys.pop_back();
-			i--;
-			continue;
+			fillWorld(count, random);
+			currentInput = inputSource->read();
+			double total = 0;
+			for (int phase = 0; phase < simulationPhasesCount; phase++)
+			{
+				auto start = std::chrono::steady_clock::now();
+				simulationPhases[phase].update();
+				double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+				samples[phase].push_back(us);
+				total += us;
+			}
+			samples[simulationPhasesCount].push_back(total);
+			ticks++;
 		}
-		enemys[i].update();
-		drawObject(enemys[i].getSprite(), enemys[i].getPostion());
-		if (enemys[i].getPostion().y >= 700)
+
+		for (int phase = 0; phase <= simulationPhasesCount; phase++)
 		{
-			player.takeDamage(1);
-			std::swap(enemys[i], enemys.back());
-			enemys.pop_back();
+			std::string name = (phase < simulationPhasesCount) ? simulationPhases[phase].name : "tick";
+			PhaseStats stats = computePhaseStats(samples[phase]);
+			results << count << " " << name << " " << stats.p50 << " " << stats.p99 << " " << stats.max << "\n";
+			std::cout << std::left << std::setw(8) << count << std::setw(18) << name << std::right << std::fixed << std::setprecision(1)
+				<< std::setw(12) << stats.p50 << std::setw(12) << stats.p99 << std::setw(12) << stats.max;
+
+			auto base = baseline.find(std::to_string(count) + " " + name);
+			if (!options.saveBaseline && base != baseline.end())
+			{
+				// 10 us zapasu, żeby szum pomiaru przy małych liczbach obiektów nie dawał fałszywych alarmów
+				bool worse = stats.p50 > base->second.p50 * (1 + options.tolerance) + 10 ||
+					stats.p99 > base->second.p99 * (1 + options.tolerance) + 10;
+				if (worse)
+				{
+					std::cout << "  REGRESSION (baseline p50 " << base->second.p50 << ", p99 " << base->second.p99 << ")";
+					regressed = true;
+				}
+			}
+			std::cout << "\n";
 		}
+		if (ticks < options.ticks)
+			std::cout << "  time budget exceeded after " << ticks << " ticks\n";
+		// stan po ostatniej klatce musi być taki sam przy każdej wartości --jobs
+		std::cout << "  state hash " << std::hex << hashWorldState() << std::dec << "\n";
 	}
-}
+	levelManager.clear();
 
-void updatePlayer()
-{
-	player.update();
-	player.draw();
+	if (options.saveBaseline)
+	{
+		std::ofstream file(options.baselinePath);
+		file << results.str();
+		std::cout << "baseline saved to " << options.baselinePath << std::endl;
+	}
+	return regressed ? 1 : 0;
 }
 
-sf::SoundBuffer soundBuffer;
-sf::Sound sound;
-void updateBacgroundMusic()
+// odtwarza nagranie bez okna, sprawdzając po każdym kroku zgodność stanu, i raportuje czasy kroków
+// przewija odtwarzanie do stanu po tick krokach: wstecz od najbliższego zapisu (albo od początku poziomu), naprzód krok po kroku;
+// zwraca liczbę wykonanych kroków
+long seekReplay(ReplayInput& input, long tick)
 {
-	if (sound.getStatus() != sf::SoundSource::Status::Playing)
-		sound.play();
+	if (tick < levelTick)
+	{
+		const WorldSnapshot* snapshot = rewindBuffer.rewindTo(tick);
+		restoreWorld(snapshot != nullptr ? *snapshot : levelStart);
+		input.seek((int)levelTick);
+	}
+	long steps = 0;
+	for (; levelTick < tick && mainMenu.getMenuState() == EMainMenuState::NO_MENU; steps++)
+		updateFrame();
+	return steps;
 }
 
-sf::Sprite backgroundSprite;
-void nextFrame()
+// seekTicks - kroki, do których odtwarzanie jest przewijane po sprawdzeniu całego nagrania
+int runReplay(const std::string& path, const std::vector<int>& seekTicks)
 {
-	updateBacgroundMusic();
-	window.draw(backgroundSprite);
-	if (mainMenu.getMenuState() == EMainMenuState::NO_MENU)
+	MappedFile file;
+	if (!file.open(path) || file.size() < sizeof(ReplayHeader))
 	{
-		levelManager.updateLevel();
-		updateCollisions();
-		updatePlayer();
-		updateBullets();
-		updateEnemys();
+		std::cerr << "cannot open replay " << path << std::endl;
+		return 1;
 	}
-	else
+	const ReplayHeader* header = (const ReplayHeader*)file.data();
+	if (std::memcmp(header->magic, replayFileMagic, sizeof(header->magic)) != 0 || header->version != replayFileVersion ||
+		file.size() != sizeof(ReplayHeader) + header->ticks * sizeof(ReplayTick))
 	{
-		mainMenu.update();
-		mainMenu.draw();
+		std::cerr << "invalid replay " << path << std::endl;
+		return 1;
 	}
-}
+	const ReplayTick* ticks = (const ReplayTick*)(file.data() + sizeof(ReplayHeader));
 
-void loadLevel1()
-{
-	levelManager.clear();
-	levelManager.addObject(LevelObjectInfo(builders_[0], 200, 0));
-	levelManager.addObject(LevelObjectInfo(builders_[0], 400, 0));
-	levelManager.addObject(LevelObjectInfo(builders_[0], 600, 0));
-	levelManager.addObject(LevelObjectInfo(builders_[0], 800, 0));
+	deltaTime = header->deltaTime;
+	randomSeed = header->seed;
+	ReplayInput replayInput(ticks, (int)header->ticks);
+	inputSource = &replayInput;
+	rewindBuffer.setEnabled(true);
+	loadLevel(header->level);
+	player.restoreState(Vector2f(header->playerX, header->playerY), header->playerHp, header->playerTimeFromLastBullet);
+	mainMenu.setMenuState(EMainMenuState::NO_MENU);
+	saveWorld(levelStart);
+
+	std::vector<double> tickTimes;
+	tickTimes.reserve(header->ticks);
+	for (std::uint32_t tick = 0; tick < header->ticks; tick++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		updateFrame();
+		tickTimes.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
 
-	levelManager.addObject(LevelObjectInfo(builders_[1], 300, 20));
-	levelManager.addObject(LevelObjectInfo(builders_[1], 500, 20));
-	levelManager.addObject(LevelObjectInfo(builders_[1], 700, 20));
+		if (hashWorldState() != ticks[tick].stateHash)
+		{
+			std::cout << "replay desync at tick " << tick << " of " << header->ticks << std::endl;
+			// ponowna symulacja od ostatniego zapisu odróżnia niedeterminizm (teraz zgodne) od zmiany w kodzie symulacji
+			long desyncTick = levelTick;
+			const WorldSnapshot* snapshot = rewindBuffer.rewindTo(desyncTick - 1);
+			restoreWorld(snapshot != nullptr ? *snapshot : levelStart);
+			replayInput.seek((int)levelTick);
+			long checkpoint = levelTick;
+			seekReplay(replayInput, desyncTick);
+			bool matches = hashWorldState() == ticks[tick].stateHash;
+			std::cout << "re-simulated from tick " << checkpoint << ": " <<
+				(matches ? "matches the recording, the simulation is not deterministic" : "same desync") << std::endl;
+			return 1;
+		}
+	}
 
-	levelManager.addObject(LevelObjectInfo(builders_[2], 400, 35));
-	levelManager.addObject(LevelObjectInfo(builders_[2], 600, 35));
+	PhaseStats stats = computePhaseStats(tickTimes);
+	std::cout << "replay ok: level " << header->level << ", " << header->ticks << " ticks identical\n"
+		<< "tick time p50 " << stats.p50 << " us, p99 " << stats.p99 << " us, max " << stats.max << " us" << std::endl;
 
-	levelManager.addObject(LevelObjectInfo(builders_[3], 500, 50));
-	levelManager.addObject(LevelObjectInfo(builders_[3], 500, 55));
-	levelManager.addObject(LevelObjectInfo(builders_[4], 500, 60));
-		
+	for (int seekTick : seekTicks)
+	{
+		long target = std::min((long)header->ticks, std::max(1L, (long)seekTick));
+		auto start = std::chrono::steady_clock::now();
+		long steps = seekReplay(replayInput, target);
+		double microseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		bool matches = levelTick == target && hashWorldState() == ticks[target - 1].stateHash;
+		std::cout << "seek to tick " << target << ": " << steps << " ticks simulated in " << microseconds << " us, "
+			<< (matches ? "state identical" : "state differs") << std::endl;
+		if (!matches)
+			return 1;
+	}
+	return 0;
 }
 
-void loadLevel2()
+// porównuje areObjectsCollide() z collideBlock() na wszystkich parach wróg-pocisk; zwraca 1, gdy liczby trafień się różnią
+int runCollisionBenchmark(int enemysCount, unsigned seed)
 {
-	levelManager.clear();
-
-	levelManager.addObject(LevelObjectInfo(builders_[0], 100, 0));
-	levelManager.addObject(LevelObjectInfo(builders_[0], 900, 0));
-
-	levelManager.addObject(LevelObjectInfo(builders_[0], 250, 5));
-	levelManager.addObject(LevelObjectInfo(builders_[0], 750, 5));
+	const int bulletsCount = 1024;
+	const double minSeconds = 0.5;
+	std::mt19937 random(seed);
 
-	levelManager.addObject(LevelObjectInfo(builders_[0], 400, 10));
-	levelManager.addObject(LevelObjectInfo(builders_[0], 600, 10));
-
-	levelManager.addObject(LevelObjectInfo(builders_[1], 500, 18));
+	std::vector<Spaceship> ships;
+	std::vector<float> left, top, right, bottom;
+	for (int i = 0; i < enemysCount; i++)
+	{
+		int enemy = enemys.find(builders_[random() % builders_.size()].create(random() % 1000));
+		enemys.setPosition(enemy, Vector2f(enemys.getPosition(enemy).x, (float)(random() % 700)));
+		auto size = enemys.getSize(enemy);
+		CollisionBox box = getCollisionBox(enemys.getPosition(enemy), size.x, size.y);
+		left.push_back(box.left);
+		top.push_back(box.top);
+		right.push_back(box.right);
+		bottom.push_back(box.bottom);
 
-	levelManager.addObject(LevelObjectInfo(builders_[2], 150, 25));
-	levelManager.addObject(LevelObjectInfo(builders_[2], 850, 25));
+		Spaceship ship(0, 0, enemys.getPosition(enemy), 0);
+		ship.setTexture(enemys.getTexture(enemy));
+		ships.push_back(ship);
+	}
+	enemys.clear();
+	for (auto* coordinates : { &left, &top, &right, &bottom })
+		coordinates->resize(enemysCount + COLLISION_BLOCK);
 
-	levelManager.addObject(LevelObjectInfo(builders_[3], 500, 40));
-	levelManager.addObject(LevelObjectInfo(builders_[3], 200, 45));
-	levelManager.addObject(LevelObjectInfo(builders_[3], 800, 45));
+	sf::Vector2u bulletSize = bullets.playerBullets.getSize();
+	std::vector<Vector2f> bulletPositions;
+	for (int i = 0; i < bulletsCount; i++)
+		bulletPositions.push_back(Vector2f((float)(random() % 1000), (float)(random() % 700)));
 
-	levelManager.addObject(LevelObjectInfo(builders_[3], 300, 70));
-	levelManager.addObject(LevelObjectInfo(builders_[3], 700, 70));
-	levelManager.addObject(LevelObjectInfo(builders_[3], 500, 75));
+	auto measure = [&](long long& hits, std::function<long long()> pass)
+	{
+		int passes = 0;
+		auto start = std::chrono::steady_clock::now();
+		double seconds = 0;
+		while (seconds < minSeconds)
+		{
+			hits = pass();
+			passes++;
+			seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		return (double)passes * enemysCount * bulletsCount / seconds;
+	};
 
-	levelManager.addObject(LevelObjectInfo(builders_[4], 500, 85));
+	const AlphaMask& bulletMask = atlas.getMask(bullets.playerBullets.getTexture());
+	long long scalarHits = 0, blockHits = 0, maskHits = 0;
+	double scalarRate = measure(scalarHits, [&]()
+	{
+		long long hits = 0;
+		for (auto& bulletPos : bulletPositions)
+			for (auto& ship : ships)
+				if (areObjectsCollide(ship, bulletPos, bulletSize))
+					hits++;
+		return hits;
+	});
+	double blockRate = measure(blockHits, [&]()
+	{
+		long long hits = 0;
+		for (auto& bulletPos : bulletPositions)
+		{
+			CollisionBox box = getCollisionBox(bulletPos, (float)bulletSize.x, (float)bulletSize.y);
+			for (int block = 0; block < enemysCount; block += COLLISION_BLOCK)
+				for (unsigned mask = collideBlock(&left[block], &top[block], &right[block], &bottom[block], box) & getBlockMask(enemysCount - block);
+					mask != 0; mask &= mask - 1)
+					hits++;
+		}
+		return hits;
+	});
+	double maskRate = measure(maskHits, [&]()
+	{
+		long long hits = 0;
+		for (auto& bulletPos : bulletPositions)
+		{
+			CollisionBox box = getCollisionBox(bulletPos, (float)bulletSize.x, (float)bulletSize.y);
+			for (int block = 0; block < enemysCount; block += COLLISION_BLOCK)
+			{
+				unsigned mask = collideBlock(&left[block], &top[block], &right[block], &bottom[block], box) & getBlockMask(enemysCount - block);
+				for (int bit = 0; mask != 0; bit++, mask >>= 1)
+				{
+					Spaceship& ship = ships[block + bit];
+					if ((mask & 1) && masksOverlap(atlas.getMask(ship.getTexture()), ship.getPostion(), bulletMask, bulletPos))
+						hits++;
+				}
+			}
+		}
+		return hits;
+	});
 
+	std::cout << enemysCount << " enemys x " << bulletsCount << " bullets\n" << std::fixed << std::setprecision(1)
+		<< "areObjectsCollide  " << std::setw(10) << scalarRate / 1e6 << " M pairs/s, hits " << scalarHits << "\n"
+		<< "collideBlock " << std::setw(6) << COLLISION_SIMD_NAME << std::setw(10) << blockRate / 1e6 << " M pairs/s, hits " << blockHits
+		<< " (x" << std::setprecision(2) << blockRate / scalarRate << ")\n" << std::setprecision(1)
+		<< "collideBlock + masks" << std::setw(10) << maskRate / 1e6 << " M pairs/s, hits " << maskHits << std::endl;
+	if (scalarHits != blockHits)
+	{
+		std::cout << "hit counts differ" << std::endl;
+		return 1;
+	}
+	return 0;
+}
 
+std::vector<int> parseCounts(const std::string& text)
+{
+	std::vector<int> counts;
+	std::istringstream stream(text);
+	std::string count;
+	while (std::getline(stream, count, ','))
+		counts.push_back(std::atoi(count.c_str()));
+	return counts;
 }
 
-void loadLevel3()
+int main(int argc, char* argv[])
 {
-	levelManager.clear();
-	for (int i = 0; i < 9; i++)
+	int level = 1;
+	long ticks = 120 * 60;
+	unsigned seed = 1;
+	bool benchmark = false;
+	bool serialLoading = false;
+	bool usePack = true;
+	std::string packPath;
+	std::vector<std::string> levelsToCompile;
+	std::string replayPath;
+	std::vector<int> seekTicks;
+	std::string profileCsvPath;
+	int fpsLimit = 0;
+	int jobsCount = (int)std::thread::hardware_concurrency();
+	int collisionBenchmarkCount = 0;
+	BenchmarkOptions benchmarkOptions;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--headless")
+			headless = true;
+		else if (arg == "--bench")
+			benchmark = headless = true;
+		else if (arg == "--bench-counts" && i + 1 < argc)
+			benchmarkOptions.counts = parseCounts(argv[++i]);
+		else if (arg == "--bench-ticks" && i + 1 < argc)
+			benchmarkOptions.ticks = std::atoi(argv[++i]);
+		else if (arg == "--bench-budget" && i + 1 < argc)
+			benchmarkOptions.budgetSeconds = (float)std::atof(argv[++i]);
+		else if (arg == "--bench-tolerance" && i + 1 < argc)
+			benchmarkOptions.tolerance = (float)std::atof(argv[++i]);
+		else if (arg == "--bench-baseline" && i + 1 < argc)
+			benchmarkOptions.baselinePath = argv[++i];
+		else if (arg == "--bench-collide")
+		{
+			headless = true;
+			collisionBenchmarkCount = (i + 1 < argc && argv[i + 1][0] != '-') ? std::atoi(argv[++i]) : 4096;
+		}
+		else if (arg == "--bench-save")
+			benchmarkOptions.saveBaseline = true;
+		else if (arg == "--serial-loading")
+			serialLoading = true;
+		else if (arg == "--no-pack")
+			usePack = false;
+		else if (arg == "--pack-assets")
+			packPath = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "assets.pak";
+		else if (arg == "--sim-rate" && i + 1 < argc)
+			deltaTime = 1.f / std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--profile-csv" && i + 1 < argc)
+			profileCsvPath = argv[++i];
+		else if (arg == "--jobs" && i + 1 < argc)
+			jobsCount = std::atoi(argv[++i]);
+		else if (arg == "--fps" && i + 1 < argc)
+			fpsLimit = std::atoi(argv[++i]);
+		else if (arg == "--record" && i + 1 < argc)
+			recorder.setPath(argv[++i]);
+		else if (arg == "--replay" && i + 1 < argc)
+			replayPath = argv[++i];
+		else if (arg == "--seek" && i + 1 < argc)
+			seekTicks = parseCounts(argv[++i]);
+		else if (arg == "--compile-levels")
+			while (i + 1 < argc)
+				levelsToCompile.push_back(argv[++i]);
+		else if (arg == "--level" && i + 1 < argc)
+			level = std::atoi(argv[++i]);
+		else if (arg == "--endless")
+			level = ENDLESS_LEVEL;
+		else if (arg == "--ticks" && i + 1 < argc)
+			ticks = std::atol(argv[++i]);
+		else if (arg == "--seed" && i + 1 < argc)
+			randomSeed = seed = std::strtoul(argv[++i], nullptr, 10);
+	}
+
+	if (!packPath.empty())
 	{
-		levelManager.addObject(LevelObjectInfo(builders_[0], (300 * i)%1000 + 50, i * 10));
-		levelManager.addObject(LevelObjectInfo(builders_[0], 1000 - ((300 * i) % 1000) - 50, i*10));
+		headless = true;
+		return packAssets(packPath);
 	}
+	if (usePack)
+		openAssetPack("assets.pak");
 
-	levelManager.addObject(LevelObjectInfo(builders_[3], 100, 95));
-	levelManager.addObject(LevelObjectInfo(builders_[3], 900, 95));
-	levelManager.addObject(LevelObjectInfo(builders_[3], 300, 100));
-	levelManager.addObject(LevelObjectInfo(builders_[3], 700, 100));
+	if (!levelsToCompile.empty())
+	{
+		headless = true;
+		loadTextures(!serialLoading);
+		createEnemysBuilders();
+		return compileLevels(levelsToCompile);
+	}
 
-	for (int i = 0; i < 5; i++)
-		levelManager.addObject(LevelObjectInfo(builders_[1], 150 * (i + 1) + 50, 120 +  i * 4));
+	jobs.start(jobsCount);
+	if (headless || !replayPath.empty())
+	{
+		headless = true;
+		loadTextures(!serialLoading);
+		player.setTexture("player");
+		bullets.setTextures();
+		createEnemysBuilders();
+		if (!replayPath.empty())
+			return runReplay(replayPath, seekTicks);
+		if (collisionBenchmarkCount > 0)
+			return runCollisionBenchmark(collisionBenchmarkCount, seed);
+		if (benchmark)
+			return runBenchmark(benchmarkOptions, seed);
+		return runHeadless(level, ticks, seed);
+	}
 
-	for (int i = 0; i < 5; i++)
-		levelManager.addObject(LevelObjectInfo(builders_[1], 1000 - (150 * (i + 1) + 50), 140 + i * 4));
+	sf::Clock startupClock;
+	startBackgroundMusic();
+	sf::Time musicTime = startupClock.getElapsedTime();
 
-	levelManager.addObject(LevelObjectInfo(builders_[4], 500, 150));
-}
+	window = std::make_unique<sf::RenderWindow>(sf::VideoMode(1000, 700), "(Space invaders)-like game");
+	DeviceInput deviceInput;
+	inputSource = &deviceInput;
+	sf::Time windowTime = startupClock.getElapsedTime();
 
-int main()
-{
-	loadTexturesFromFiles();
-	backgroundSprite.setTexture(textures["bg"]);
-	soundBuffer.loadFromFile("music/muzyka.wav");
-	sound.setBuffer(soundBuffer);
-	player.setTexture("player");
-	player.setHpTexture("heart");
+	loadTextures(!serialLoading);
+	sf::Time texturesTime = startupClock.getElapsedTime();
+	setSpritesTextures();
 	createEnemysBuilders();
-	mainMenu.setButtonsTextures();
-	window.setFramerateLimit(120);
-	mainMenu.setMenuState(EMainMenuState::START_MENU);
+	// limit klatek jest realizowany ręcznie zamiast przez setFramerateLimit, żeby profiler widział czas uśpienia;
+	// przy vsync czekanie odbywa się w display()
+	if (fpsLimit <= 0)
+		window->setVerticalSyncEnabled(true);
+	profiler.setEnabled(true);
+	if (!profileCsvPath.empty())
+		profiler.openCsv(profileCsvPath);
+	if (level == ENDLESS_LEVEL)
+		loadLevel(ENDLESS_LEVEL);
+	else
+		mainMenu.setMenuState(EMainMenuState::START_MENU);
 	//loadLevel1();
 
-	while (window.isOpen())
+	SharedInput sharedInput;
+	inputSource = &sharedInput;
+	rewindBuffer.setEnabled(true);
+	simulationGate.setRunning(true);
+	std::thread simulationThread(runSimulation);
+
+	std::vector<std::string> watchedFiles = atlas.getPaths();
+	if (!musicPath.empty())
+		watchedFiles.push_back(musicPath);
+	for (int i = 1; i <= 3; i++)
+	{
+		watchedFiles.push_back("levels/level" + std::to_string(i) + ".txt");
+		watchedFiles.push_back("levels/level" + std::to_string(i) + ".lvl");
+	}
+	AssetWatcher assetWatcher;
+	assetWatcher.start({ "img", "music", "levels" }, watchedFiles);
+
+	// wątek główny obsługuje okno: zdarzenia, odczyt urządzeń i rysowanie najnowszej migawki
+	sf::Clock frameLimitClock;
+	bool firstFrame = true;
+	while (window->isOpen())
 	{
 		sf::Event event;
-		while (window.pollEvent(event))
 		{
-			if (event.type == sf::Event::Closed)
-				window.close();
+			ScopedTimer timer(PROFILE_EVENTS);
+			while (window->pollEvent(event))
+			{
+				deviceInput.handleEvent(event);
+				if (event.type == sf::Event::Closed)
+				{
+					quitRequested = true;
+				}
+				else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Backspace)
+				{
+					rewindRequests++;
+				}
+				else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F3)
+				{
+					profiler.toggleOverlay();
+				}
+				else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F4)
+				{
+					if (profiler.isCsvOpen())
+						profiler.closeCsv();
+					else
+						profiler.openCsv(profileCsvPath.empty() ? "profile.csv" : profileCsvPath);
+				}
+			}
+			InputState pressed;
+			InputState held = deviceInput.read(pressed);
+			sharedInput.publish(held, pressed);
+			profiler.setInputLatency(deviceInput.getLatency());
+		}
+		if (quitRequested)
+		{
+			window->close();
+			break;
 		}
+		assetWatcher.applyChanges();
 
-		window.clear();
-		nextFrame();
-		window.display();
+		const RenderSnapshot& snapshot = snapshots.acquire();
+		window->clear();
+		drawSnapshot(snapshot);
+		profiler.drawOverlay(*window);
+		{
+			ScopedTimer timer(PROFILE_DISPLAY);
+			window->display();
+		}
+		if (fpsLimit > 0)
+		{
+			ScopedTimer timer(PROFILE_SLEEP);
+			sf::sleep(sf::seconds(1.f / fpsLimit) - frameLimitClock.getElapsedTime());
+		}
+		frameLimitClock.restart();
+		profiler.endFrame(snapshot.enemysCount, snapshot.playerBulletsCount, snapshot.enemyBulletsCount);
+
+		if (firstFrame)
+		{
+			firstFrame = false;
+			std::cout << "startup (" << (serialLoading ? "serial" : "parallel") << " loading): music " << musicTime.asMilliseconds()
+				<< " ms, window " << (windowTime - musicTime).asMilliseconds()
+				<< " ms, textures " << (texturesTime - windowTime).asMilliseconds()
+				<< " ms, first frame after " << startupClock.getElapsedTime().asMilliseconds() << " ms" << std::endl;
+		}
 	}
 
+	quitRequested = true;
+	simulationThread.join();
+	recorder.stop();
+
 	return 0;
 }
\ No newline at end of file